@@ -0,0 +1,342 @@
+#!/usr/bin/env python3
+#
+# noise-repellent -- Noise Reduction LV2
+#
+# Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 3 of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+# Writes the description of the multichannel variants. LV2 needs every port
+# spelled out, so the audio ports of each channel layout are generated here
+# instead of keeping one ttl file per layout.
+#
+# Usage: nrepellent_multichannel_ttl.py OUTPUT MINOR_VERSION MICRO_VERSION
+
+import sys
+
+PLUGIN_URI = "https://github.com/lucianodato/noise-repellent-multichannel"
+
+# Must match the multichannel variants listed in plugins/nrepellent.c
+CHANNEL_LAYOUTS = [4, 6, 8, 12, 16]
+
+# Controls, parallel switch and monitors come first so their indices are the
+# same for every layout
+FIRST_AUDIO_PORT = 15
+
+HEADER = """@prefix doap: <http://usefulinc.com/ns/doap#> .
+@prefix foaf: <http://xmlns.com/foaf/0.1/> .
+@prefix lv2: <http://lv2plug.in/ns/lv2core#> .
+@prefix param: <http://lv2plug.in/ns/ext/parameters#> .
+@prefix rdf: <http://www.w3.org/1999/02/22-rdf-syntax-ns#> .
+@prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> .
+@prefix pg: <http://lv2plug.in/ns/ext/port-groups#> .
+@prefix pprop: <http://lv2plug.in/ns/ext/port-props#> .
+@prefix units: <http://lv2plug.in/ns/extensions/units#> .
+@prefix state: <http://lv2plug.in/ns/ext/state#> .
+@prefix urid: <http://lv2plug.in/ns/ext/urid#> .
+@prefix bufsz: <http://lv2plug.in/ns/ext/buf-size#> .
+@prefix opts: <http://lv2plug.in/ns/ext/options#> .
+@prefix work: <http://lv2plug.in/ns/ext/worker#> .
+
+<https://github.com/lucianodato#me>
+  a foaf:Person ;
+  foaf:name "Luciano Dato" ;
+  foaf:homepage <https://github.com/lucianodato> ;
+  foaf:mbox <mailto:lucianodato@gmail.com> .
+
+"""
+
+PLUGIN = """<{uri}>
+  a lv2:Plugin, lv2:SpectralPlugin, lv2:UtilityPlugin, doap:Project ;
+  doap:maintainer <https://github.com/lucianodato#me> ;
+  doap:license <https://opensource.org/licenses/LGPL-3.0> ;
+  doap:name "Repelente de ruido ({channels} canales)"@es ,
+    "Répulseur de bruit ({channels} canaux)"@fr ,
+    "Noise repellent ({channels} channels)" ;
+  doap:shortdesc "Un plugin LV2 para la reduccion de ruido"@es ,
+               "Un greffon LV2 pour la réduction du bruit à large bande"@fr ,
+               "An LV2 plugin for broadband noise reduction" ;
+  lv2:project <{uri}> ;
+  lv2:optionalFeature lv2:isLive, lv2:hardRTCapable, work:schedule, opts:options,
+    bufsz:boundedBlockLength, bufsz:fixedBlockLength ;
+  lv2:extensionData state:interface, work:interface ;
+  lv2:requiredFeature urid:map ;
+  opts:supportedOption bufsz:maxBlockLength, bufsz:nominalBlockLength ;
+
+  lv2:minorVersion {minor_version} ;
+  lv2:microVersion {micro_version} ;
+
+  lv2:port [
+    a lv2:ControlPort,
+      lv2:InputPort ;
+    lv2:index 0 ;
+    lv2:symbol "reduction" ;
+    lv2:name "Cantidad de reduccion"@es ,
+      "Quantité de réduction"@fr ,
+      "Reduction amount" ;
+    lv2:minimum 0.0 ;
+    lv2:maximum 40.0 ;
+    lv2:default 10.0 ;
+    lv2:designation lv2:threshold ;
+    units:unit units:db ;
+    units:conversion [
+			units:to units:coef;
+		];
+  ], [
+    a lv2:ControlPort,
+      lv2:InputPort ;
+    lv2:index 1 ;
+    lv2:symbol "offset" ;
+    lv2:name "Fuerza de reduccion"@es ,
+      "Force de réduction"@fr ,
+      "Reduction strenght" ;
+    lv2:minimum 0.0 ;
+    lv2:maximum 12.0 ;
+    lv2:default 2.0 ;
+    lv2:designation lv2:gain ;
+    units:unit units:db ;
+  ], [
+    a lv2:ControlPort,
+      lv2:InputPort ;
+    lv2:index 2 ;
+    lv2:symbol "smoothing" ;
+    lv2:name "Suavizado"@es ,
+      "Lissage"@fr ,
+      "Smoothing" ;
+    lv2:minimum 0.0 ;
+    lv2:maximum 100.0 ;
+    lv2:default 0.0 ;
+    units:unit units:pc ;
+  ], [
+    a lv2:ControlPort,
+      lv2:InputPort ;
+    lv2:index 3 ;
+    lv2:symbol "whitening" ;
+    lv2:name "Blanqueo de residuo"@es ,
+      "Blanchissement du bruit"@fr ,
+      "Residual whitening" ;
+    lv2:minimum 0.0 ;
+    lv2:maximum 100.0 ;
+    lv2:default 0.0 ;
+    units:unit units:pc ;
+  ], [    
+    a lv2:ControlPort,
+      lv2:InputPort ;
+    lv2:index 4 ;
+    lv2:symbol "transient_protection" ;
+    lv2:name "Proteger transientes"@es ,
+      "Protéger les transitoires"@fr ,
+      "Protect Transients" ;
+    lv2:minimum 0 ;
+    lv2:maximum 1 ;
+    lv2:default 0 ;
+    lv2:portProperty lv2:toggled, lv2:integer ;
+  ], [
+    a lv2:ControlPort,
+      lv2:InputPort ;
+    lv2:index 5 ;
+    lv2:symbol "noise_learn" ;
+    lv2:name "Aprender perfil de ruido"@es ,
+      "Apprendre le profil du bruit"@fr , 
+      "Learn noise profile" ;
+    lv2:minimum 0 ;
+    lv2:maximum 1 ;
+    lv2:default 0 ;
+    lv2:portProperty lv2:toggled, lv2:integer ;
+  ], [    
+    a lv2:InputPort,
+    lv2:ControlPort ;
+    lv2:index 6 ;
+    lv2:symbol "Residual_listen" ;
+    lv2:name "Escuchar Residuo"@es ,
+      "Écoute résiduelle"@fr ,
+      "Residual listen" ;
+    lv2:minimum 0 ;
+    lv2:maximum 1 ;
+    lv2:default 0 ;
+    lv2:portProperty lv2:toggled, lv2:integer ;
+  ], [
+    a lv2:InputPort,
+    lv2:ControlPort ;
+    lv2:index 7 ;
+    lv2:symbol "reset_noise_profile" ;
+    lv2:name "Reiniciar perfil de ruido"@es ,
+      "Réinitialiser le profil de bruit"@fr ,
+      "Reset noise profile" ;
+    lv2:minimum 0 ;
+    lv2:maximum 1 ;
+    lv2:default 0 ;
+    lv2:portProperty lv2:toggled, lv2:integer, pprop:trigger;
+  ], [
+    a lv2:InputPort, lv2:ControlPort ;
+    lv2:index 8 ;
+    lv2:name "Activar"@es ,
+      "Actif"@fr ,
+      "Enable" ;
+    lv2:symbol "enable" ;
+    lv2:minimum 0 ;
+    lv2:maximum 1 ;
+    lv2:default 1 ;
+    lv2:designation lv2:enabled ;
+    lv2:portProperty lv2:toggled, lv2:integer ; 
+  ], [
+    a lv2:OutputPort,
+      lv2:ControlPort ;
+    lv2:name "latency" ;
+    lv2:index 9 ;
+    lv2:symbol "latency" ;
+    lv2:minimum 0 ;
+    lv2:maximum 8192 ;
+    lv2:designation lv2:latency ;
+    lv2:portProperty lv2:integer ;
+    units:unit units:frame ;
+  ], [
+    a lv2:InputPort,
+    lv2:ControlPort ;
+    lv2:index 10 ;
+    lv2:symbol "parallel" ;
+    lv2:name "Procesamiento en paralelo"@es ,
+      "Traitement en parallèle"@fr ,
+      "Parallel processing" ;
+    lv2:minimum 0 ;
+    lv2:maximum 1 ;
+    lv2:default 1 ;
+    lv2:portProperty lv2:toggled, lv2:integer, pprop:expensive, pprop:notAutomatic ;
+  ], [
+    a lv2:OutputPort,
+      lv2:ControlPort ;
+    lv2:index 11 ;
+    lv2:symbol "cycle_time" ;
+    lv2:name "Tiempo de ciclo"@es ,
+      "Temps de cycle"@fr ,
+      "Cycle time" ;
+    lv2:minimum 0 ;
+    lv2:maximum 100 ;
+    lv2:portProperty lv2:connectionOptional ;
+    units:unit units:ms ;
+  ], [
+    a lv2:OutputPort,
+      lv2:ControlPort ;
+    lv2:index 12 ;
+    lv2:symbol "peak_cycle_time" ;
+    lv2:name "Tiempo de ciclo máximo"@es ,
+      "Temps de cycle maximal"@fr ,
+      "Peak cycle time" ;
+    lv2:minimum 0 ;
+    lv2:maximum 100 ;
+    lv2:portProperty lv2:connectionOptional ;
+    units:unit units:ms ;
+  ], [
+    a lv2:OutputPort,
+      lv2:ControlPort ;
+    lv2:index 13 ;
+    lv2:symbol "learned_blocks" ;
+    lv2:name "Bloques aprendidos"@es ,
+      "Blocs appris"@fr ,
+      "Learned blocks" ;
+    lv2:minimum 0 ;
+    lv2:maximum 100000 ;
+    lv2:portProperty lv2:connectionOptional, lv2:integer ;
+  ], [
+    a lv2:OutputPort,
+      lv2:ControlPort ;
+    lv2:index 14 ;
+    lv2:symbol "mean_reduction" ;
+    lv2:name "Reducción media"@es ,
+      "Réduction moyenne"@fr ,
+      "Mean reduction" ;
+    lv2:minimum -10 ;
+    lv2:maximum 60 ;
+    lv2:portProperty lv2:connectionOptional ;
+    units:unit units:db ;
+  ], [
+{audio_ports}
+  ];
+  rdfs:comment "Un plugin LV2 para la reduccion de ruido multicanal. Cada canal aprende su propio perfil de ruido"@es,
+               "Un greffon LV2 pour la réduction du bruit multicanal. Chaque canal apprend son propre profil de bruit"@fr,
+               "An LV2 plugin for multichannel broadband noise reduction. Each channel learns its own noise profile" ;
+.
+"""
+
+AUDIO_PORT = """    a lv2:AudioPort,
+      lv2:{direction}Port ;
+    lv2:index {index} ;
+    lv2:symbol "{symbol}_{channel}" ;
+    lv2:name "{name} {channel}" ;"""
+
+# Added after the audio ports to keep the indices of existing ports
+FREE_WHEELING_PORT = """    a lv2:InputPort,
+    lv2:ControlPort ;
+    lv2:index {index} ;
+    lv2:symbol "free_wheeling" ;
+    lv2:name "Renderizado sin conexion"@es ,
+      "Rendu hors ligne"@fr ,
+      "Free wheeling" ;
+    lv2:minimum 0 ;
+    lv2:maximum 1 ;
+    lv2:default 0 ;
+    lv2:designation lv2:freeWheeling ;
+    lv2:portProperty lv2:toggled, lv2:integer, lv2:connectionOptional, pprop:notOnGUI ;"""
+
+PROFILE_SLOT_PORT = """    a lv2:InputPort,
+    lv2:ControlPort ;
+    lv2:index {index} ;
+    lv2:symbol "profile_slot" ;
+    lv2:name "Perfil compartido"@es ,
+      "Profil partagé"@fr ,
+      "Shared profile slot" ;
+    lv2:minimum 0 ;
+    lv2:maximum 16 ;
+    lv2:default 0 ;
+    lv2:portProperty lv2:integer, lv2:connectionOptional, pprop:notAutomatic ;"""
+
+
+def audio_ports(channels):
+    ports = []
+    for channel in range(channels):
+        index = FIRST_AUDIO_PORT + 2 * channel
+        ports.append(AUDIO_PORT.format(direction="Input", index=index,
+                                       symbol="input", name="Input",
+                                       channel=channel + 1))
+        ports.append(AUDIO_PORT.format(direction="Output", index=index + 1,
+                                       symbol="output", name="Output",
+                                       channel=channel + 1))
+    ports.append(FREE_WHEELING_PORT.format(
+        index=FIRST_AUDIO_PORT + 2 * channels))
+    ports.append(PROFILE_SLOT_PORT.format(
+        index=FIRST_AUDIO_PORT + 2 * channels + 1))
+    return "\n  ], [\n".join(ports)
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.exit("usage: {} OUTPUT MINOR_VERSION MICRO_VERSION".format(
+            sys.argv[0]))
+
+    output, minor_version, micro_version = sys.argv[1:]
+
+    plugins = [HEADER]
+    for channels in CHANNEL_LAYOUTS:
+        plugins.append(PLUGIN.format(
+            uri="{}#{}ch".format(PLUGIN_URI, channels),
+            channels=channels, minor_version=minor_version,
+            micro_version=micro_version, audio_ports=audio_ports(channels)))
+
+    with open(output, "w", encoding="utf-8") as ttl:
+        ttl.write("\n".join(plugins))
+
+
+if __name__ == "__main__":
+    main()
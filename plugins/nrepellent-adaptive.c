@@ -18,31 +18,90 @@ along with this program; if not, write to the Free Software Foundation,
 Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
+#include "../src/block_length.h"
+#include "../src/control_smoother.h"
+#include "../src/delay_line.h"
+#include "../src/memory_arena.h"
+#include "../src/noise_profile_state.h"
+#include "../src/planner_lock.h"
+#include "../src/processing_monitor.h"
+#include "../src/processing_pool.h"
 #include "../src/signal_crossfade.h"
+#include "../src/silence_gate.h"
+#include "../src/signal_history.h"
+#include "../src/speech_band.h"
 #include "lv2/atom/atom.h"
 #include "lv2/core/lv2.h"
 #include "lv2/core/lv2_util.h"
 #include "lv2/log/logger.h"
+#include "lv2/options/options.h"
+#include "lv2/state/state.h"
 #include "lv2/urid/urid.h"
+#include "lv2/worker/worker.h"
 #include "specbleach_adenoiser.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define NOISEREPELLENT_ADAPTIVE_URI                                            \
   "https://github.com/lucianodato/noise-repellent#adaptive"
 #define NOISEREPELLENT_ADAPTIVE_STEREO_URI                                     \
   "https://github.com/lucianodato/noise-repellent#adaptive-stereo"
 
+// The adaptive estimate is not reachable from outside the library. When warm
+// start is on, the last seconds of input are saved instead and replayed
+// through new denoisers after restore, which then start converged
+#define WARM_START_SECONDS 2U
+#define MAX_STATE_KEY_SIZE 256U
+#define DELAY_FADE_MS 20.F
+
 typedef struct URIs {
+  LV2_URID atom_Int;
+  LV2_URID atom_Float;
+  LV2_URID atom_Vector;
   LV2_URID plugin;
 } URIs;
 
+typedef struct State {
+  LV2_URID property_input_histories[2];
+  LV2_URID property_input_history_size;
+} State;
+
 static void map_uris(LV2_URID_Map *map, URIs *uris, const char *uri) {
   uris->plugin =
       strcmp(uri, NOISEREPELLENT_ADAPTIVE_URI)
           ? map->map(map->handle, NOISEREPELLENT_ADAPTIVE_URI)
           : map->map(map->handle, NOISEREPELLENT_ADAPTIVE_STEREO_URI);
+  uris->atom_Int = map->map(map->handle, LV2_ATOM__Int);
+  uris->atom_Float = map->map(map->handle, LV2_ATOM__Float);
+  uris->atom_Vector = map->map(map->handle, LV2_ATOM__Vector);
+}
+
+static void map_state(LV2_URID_Map *map, State *state, const char *uri) {
+  char key[MAX_STATE_KEY_SIZE];
+
+  snprintf(key, sizeof(key), "%s#inputhistory", uri);
+  state->property_input_histories[0] = map->map(map->handle, key);
+  snprintf(key, sizeof(key), "%s#inputhistory2", uri);
+  state->property_input_histories[1] = map->map(map->handle, key);
+  snprintf(key, sizeof(key), "%s#inputhistorysize", uri);
+  state->property_input_history_size = map->map(map->handle, key);
 }
 
+typedef enum WorkType {
+  WORK_SWITCH_LATENCY = 0,
+  WORK_FREE_INSTANCES = 1,
+} WorkType;
+
+// Denoisers for another band mode, or warmed up with a restored history, are
+// built and freed in the worker. The message carries them between threads
+typedef struct LatencyWork {
+  uint32_t type;
+  bool speech_band;
+  SpectralBleachHandle lib_instances[2];
+  SpeechBand *speech_bands[2];
+} LatencyWork;
+
 typedef enum PortIndex {
   NOISEREPELLENT_AMOUNT = 0,
   NOISEREPELLENT_NOISE_OFFSET = 1,
@@ -54,8 +113,34 @@ typedef enum PortIndex {
   NOISEREPELLENT_OUTPUT_1 = 7,
   NOISEREPELLENT_INPUT_2 = 8,
   NOISEREPELLENT_OUTPUT_2 = 9,
+  NOISEREPELLENT_PARALLEL = 10,
 } PortIndex;
 
+// Monitoring outputs come after the last port of each variant
+typedef enum MonitorPortIndex {
+  NOISEREPELLENT_CYCLE_TIME = 0,
+  NOISEREPELLENT_PEAK_CYCLE_TIME = 1,
+  NOISEREPELLENT_MEAN_REDUCTION = 2,
+} MonitorPortIndex;
+
+#define MONO_MONITOR_PORTS_START 8U
+#define STEREO_MONITOR_PORTS_START 11U
+
+// Added after the monitors to keep the indices of existing ports
+#define MONO_FREE_WHEELING_PORT 11U
+#define STEREO_FREE_WHEELING_PORT 14U
+#define MONO_SPEECH_BAND_PORT 12U
+#define STEREO_SPEECH_BAND_PORT 15U
+#define MONO_WARM_START_PORT 13U
+#define STEREO_WARM_START_PORT 16U
+
+typedef enum SmoothedControl {
+  SMOOTHED_REDUCTION_AMOUNT = 0,
+  SMOOTHED_NOISE_RESCALE = 1,
+  SMOOTHED_SMOOTHING_FACTOR = 2,
+  NUMBER_OF_SMOOTHED_CONTROLS = 3,
+} SmoothedControl;
+
 typedef struct NoiseRepellentAdaptivePlugin {
   const float *input_1;
   const float *input_2;
@@ -66,37 +151,119 @@ typedef struct NoiseRepellentAdaptivePlugin {
 
   LV2_URID_Map *map;
   LV2_Log_Logger log;
+  LV2_Worker_Schedule *schedule;
   URIs uris;
+  State state;
   char *plugin_uri;
 
-  SpectralBleachHandle lib_instance_1;
-  SpectralBleachHandle lib_instance_2;
+  SpectralBleachHandle lib_instances[2];
+  SpeechBand *speech_bands[2];
+  uint32_t number_of_channels;
   SpectralBleachParameters parameters;
+  ControlSmoother *control_smoother;
+  bool parameters_pending;
   SignalCrossfade *soft_bypass;
+  ProcessingPool *processing_pool;
+  ProcessingMonitor *processing_monitor;
+  BlockLength block_length;
+  MemoryArena *memory_arena;
+  float *dry_signals[2];
+  float *delayed_signals[2];
+  DelayLine *delay_lines[2];
+  SilenceGate *silence_gates[2];
+  const float *const *block_inputs;
+  float *const *block_outputs;
+  uint32_t number_of_samples;
+  uint32_t latency;
+  bool speech_band_requested;
+  bool warm_start_pending;
+  bool denoisers_ready;
+  bool denoiser_bypassed;
+  uint32_t warmup_samples;
+  SignalHistory *input_histories[2];
+  NoiseProfileState *input_history_states[2];
 
   float *enable;
   float *residual_listen;
   float *reduction_amount;
   float *smoothing_factor;
   float *noise_rescale;
+  float *parallel;
+  float *free_wheeling;
+  float *speech_band;
+  float *warm_start;
+
+  float *cycle_time;
+  float *peak_cycle_time;
+  float *mean_reduction;
 
 } NoiseRepellentAdaptivePlugin;
 
-static void cleanup(LV2_Handle instance) {
-  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+static SpectralBleachHandle create_denoiser(const uint32_t sample_rate) {
+  planner_lock_acquire();
+  SpectralBleachHandle lib_instance =
+      specbleach_adaptive_initialize(sample_rate);
+  planner_lock_release();
+  return lib_instance;
+}
 
-  if (self->lib_instance_1) {
-    specbleach_adaptive_free(self->lib_instance_1);
+static void free_instances(SpectralBleachHandle *lib_instances,
+                           SpeechBand **speech_bands) {
+  planner_lock_acquire();
+  for (uint32_t channel = 0U; channel < 2U; channel++) {
+    if (lib_instances[channel]) {
+      specbleach_adaptive_free(lib_instances[channel]);
+      lib_instances[channel] = NULL;
+    }
   }
+  planner_lock_release();
 
-  if (self->lib_instance_2) {
-    specbleach_adaptive_free(self->lib_instance_2);
+  for (uint32_t channel = 0U; channel < 2U; channel++) {
+    if (speech_bands[channel]) {
+      speech_band_free(speech_bands[channel]);
+      speech_bands[channel] = NULL;
+    }
   }
+}
+
+static void cleanup(LV2_Handle instance) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+
+  processing_pool_release(self->processing_pool);
+
+  free_instances(self->lib_instances, self->speech_bands);
 
   if (self->plugin_uri) {
     free(self->plugin_uri);
   }
 
+  if (self->memory_arena) {
+    memory_arena_free(self->memory_arena);
+  }
+
+  for (uint32_t channel = 0U; channel < 2U; channel++) {
+    if (self->input_histories[channel]) {
+      signal_history_free(self->input_histories[channel]);
+    }
+    if (self->input_history_states[channel]) {
+      noise_profile_state_free(self->input_history_states[channel]);
+    }
+    if (self->delay_lines[channel]) {
+      delay_line_free(self->delay_lines[channel]);
+    }
+    if (self->silence_gates[channel]) {
+      silence_gate_free(self->silence_gates[channel]);
+    }
+  }
+
+  if (self->control_smoother) {
+    control_smoother_free(self->control_smoother);
+  }
+
+  if (self->processing_monitor) {
+    processing_monitor_free(self->processing_monitor);
+  }
+
   if (self->soft_bypass) {
     signal_crossfade_free(self->soft_bypass);
   }
@@ -104,17 +271,112 @@ static void cleanup(LV2_Handle instance) {
   free(instance);
 }
 
+static uint32_t get_denoiser_rate(const NoiseRepellentAdaptivePlugin *self,
+                                  const LatencyWork *work) {
+  const uint32_t rate = (uint32_t)self->sample_rate;
+  return work->speech_band ? rate / 2U : rate;
+}
+
+static uint32_t get_history_length(const NoiseRepellentAdaptivePlugin *self) {
+  return WARM_START_SECONDS * (uint32_t)self->sample_rate;
+}
+
+static bool initialize_input_history(NoiseRepellentAdaptivePlugin *self,
+                                     const uint32_t channel) {
+  const uint32_t length = get_history_length(self);
+
+  self->input_histories[channel] = signal_history_initialize(length);
+  self->input_history_states[channel] =
+      noise_profile_state_initialize(self->uris.atom_Float, length);
+
+  return self->input_histories[channel] &&
+         self->input_history_states[channel];
+}
+
+// Built on first activation or restore rather than in instantiate
+static bool initialize_denoisers(NoiseRepellentAdaptivePlugin *self) {
+  if (self->denoisers_ready) {
+    return true;
+  }
+
+  // Leftovers of a failed attempt are freed by cleanup
+  if (self->lib_instances[0]) {
+    return false;
+  }
+
+  self->lib_instances[0] = create_denoiser((uint32_t)self->sample_rate);
+  if (!self->lib_instances[0]) {
+    return false;
+  }
+
+  self->latency = specbleach_adaptive_get_latency(self->lib_instances[0]);
+
+  // Buffers touched on every cycle are carved from a single block, keeping
+  // the working set of an instance contiguous
+  self->memory_arena = memory_arena_initialize(
+      2U * self->number_of_channels *
+      memory_arena_get_slice_size(self->block_length.maximum * sizeof(float)));
+  if (!self->memory_arena) {
+    return false;
+  }
+
+#if defined(LOCK_MEMORY)
+  if (!memory_arena_lock(self->memory_arena)) {
+    lv2_log_note(&self->log, "Unable to lock memory of <%s>\n",
+                 self->plugin_uri);
+  }
+#endif
+
+  // Sized for the full rate denoiser. The speech band one works on half of the
+  // samples but adds its filters
+  for (uint32_t channel = 0U; channel < self->number_of_channels; channel++) {
+    self->dry_signals[channel] = (float *)memory_arena_allocate(
+        self->memory_arena, self->block_length.maximum * sizeof(float));
+    self->delayed_signals[channel] = (float *)memory_arena_allocate(
+        self->memory_arena, self->block_length.maximum * sizeof(float));
+
+    self->delay_lines[channel] = delay_line_initialize(
+        2U * self->latency + 2U * SPEECH_BAND_FILTER_DELAY);
+    self->silence_gates[channel] = silence_gate_initialize(self->latency);
+    if (!self->delay_lines[channel] || !self->silence_gates[channel] ||
+        !initialize_input_history(self, channel)) {
+      return false;
+    }
+    delay_line_set_delay(self->delay_lines[channel], self->latency);
+  }
+
+  if (self->number_of_channels == 2U) {
+    self->lib_instances[1] = create_denoiser((uint32_t)self->sample_rate);
+
+    if (!self->lib_instances[1]) {
+      return false;
+    }
+
+    self->processing_pool = processing_pool_acquire();
+    if (!self->processing_pool) {
+      lv2_log_note(&self->log, "Parallel processing unavailable for <%s>\n",
+                   self->plugin_uri);
+    }
+  }
+
+  self->denoisers_ready = true;
+  return true;
+}
+
 static LV2_Handle instantiate(const LV2_Descriptor *descriptor,
                               const double rate, const char *bundle_path,
                               const LV2_Feature *const *features) {
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)calloc(
       1U, sizeof(NoiseRepellentAdaptivePlugin));
+  const LV2_Options_Option *options = NULL;
 
   // clang-format off
   const char *missing =
       lv2_features_query(features,
                          LV2_LOG__log, &self->log.log, false,
                          LV2_URID__map, &self->map, true,
+                         LV2_WORKER__schedule, &self->schedule, false,
+                         LV2_OPTIONS__options, &options, false,
                          NULL);
   // clang-format on
 
@@ -137,34 +399,28 @@ static LV2_Handle instantiate(const LV2_Descriptor *descriptor,
   }
 
   map_uris(self->map, &self->uris, self->plugin_uri);
+  map_state(self->map, &self->state, self->plugin_uri);
 
   self->sample_rate = (float)rate;
 
-  self->lib_instance_1 =
-      specbleach_adaptive_initialize((uint32_t)self->sample_rate);
-  if (!self->lib_instance_1) {
-    cleanup((LV2_Handle)self);
-    return NULL;
-  }
+  // Scratch memory is sized once for the longest block the host may send
+  self->block_length = block_length_read_options(self->map, options);
+
+  self->number_of_channels =
+      strstr(self->plugin_uri, NOISEREPELLENT_ADAPTIVE_STEREO_URI) ? 2U : 1U;
 
   self->soft_bypass = signal_crossfade_initialize((uint32_t)self->sample_rate);
+  self->control_smoother = control_smoother_initialize(
+      NUMBER_OF_SMOOTHED_CONTROLS, (uint32_t)self->sample_rate);
+  self->processing_monitor =
+      processing_monitor_initialize((uint32_t)self->sample_rate);
 
-  if (!self->soft_bypass) {
+  if (!self->soft_bypass || !self->control_smoother ||
+      !self->processing_monitor) {
     cleanup((LV2_Handle)self);
     return NULL;
   }
 
-  if (strstr(self->plugin_uri, NOISEREPELLENT_ADAPTIVE_STEREO_URI)) {
-    self->lib_instance_2 =
-        specbleach_adaptive_initialize((uint32_t)self->sample_rate);
-
-    if (!self->lib_instance_2) {
-      lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
-      cleanup((LV2_Handle)self);
-      return NULL;
-    }
-  }
-
   return (LV2_Handle)self;
 }
 
@@ -201,10 +457,74 @@ static void connect_port(LV2_Handle instance, uint32_t port, void *data) {
   }
 }
 
+static void connect_monitor_port(NoiseRepellentAdaptivePlugin *self,
+                                 const uint32_t port, void *data) {
+  switch ((MonitorPortIndex)port) {
+  case NOISEREPELLENT_CYCLE_TIME:
+    self->cycle_time = (float *)data;
+    break;
+  case NOISEREPELLENT_PEAK_CYCLE_TIME:
+    self->peak_cycle_time = (float *)data;
+    break;
+  case NOISEREPELLENT_MEAN_REDUCTION:
+    self->mean_reduction = (float *)data;
+    break;
+  default:
+    break;
+  }
+}
+
+static void connect_port_mono(LV2_Handle instance, uint32_t port,
+                              void *data) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+
+  if (port == MONO_FREE_WHEELING_PORT) {
+    self->free_wheeling = (float *)data;
+    return;
+  }
+
+  if (port == MONO_SPEECH_BAND_PORT) {
+    self->speech_band = (float *)data;
+    return;
+  }
+
+  if (port == MONO_WARM_START_PORT) {
+    self->warm_start = (float *)data;
+    return;
+  }
+
+  if (port >= MONO_MONITOR_PORTS_START) {
+    connect_monitor_port(self, port - MONO_MONITOR_PORTS_START, data);
+    return;
+  }
+
+  connect_port(instance, port, data);
+}
+
 static void connect_port_stereo(LV2_Handle instance, uint32_t port,
                                 void *data) {
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
 
+  if (port == STEREO_FREE_WHEELING_PORT) {
+    self->free_wheeling = (float *)data;
+    return;
+  }
+
+  if (port == STEREO_SPEECH_BAND_PORT) {
+    self->speech_band = (float *)data;
+    return;
+  }
+
+  if (port == STEREO_WARM_START_PORT) {
+    self->warm_start = (float *)data;
+    return;
+  }
+
+  if (port >= STEREO_MONITOR_PORTS_START) {
+    connect_monitor_port(self, port - STEREO_MONITOR_PORTS_START, data);
+    return;
+  }
+
   connect_port(instance, port, data);
 
   switch ((PortIndex)port) {
@@ -214,6 +534,9 @@ static void connect_port_stereo(LV2_Handle instance, uint32_t port,
   case NOISEREPELLENT_OUTPUT_2:
     self->output_2 = (float *)data;
     break;
+  case NOISEREPELLENT_PARALLEL:
+    self->parallel = (float *)data;
+    break;
   default:
     break;
   }
@@ -222,55 +545,631 @@ static void connect_port_stereo(LV2_Handle instance, uint32_t port,
 static void activate(LV2_Handle instance) {
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
 
-  *self->report_latency =
-      (float)specbleach_adaptive_get_latency(self->lib_instance_1);
+  if (!initialize_denoisers(self)) {
+    lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
+    return;
+  }
+
+  *self->report_latency = (float)self->latency;
 }
 
-static void run(LV2_Handle instance, uint32_t number_of_samples) {
-  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+// In speech band mode only a decimated copy of the lower half of the
+// spectrum goes through the denoiser
+static void run_denoiser(SpectralBleachHandle lib_instance,
+                         SpeechBand *speech_band,
+                         const uint32_t number_of_samples, const float *input,
+                         float *output, const bool residual_listen) {
+  if (!speech_band) {
+    specbleach_adaptive_process(lib_instance, number_of_samples, input,
+                                output);
+    return;
+  }
+
+  const uint32_t low_band_samples =
+      speech_band_split(speech_band, number_of_samples, input);
+  specbleach_adaptive_process(lib_instance, low_band_samples,
+                              speech_band_get_low_band(speech_band),
+                              speech_band_get_denoised_low_band(speech_band));
+  speech_band_merge(speech_band, number_of_samples, residual_listen, output);
+}
+
+// Feeds past input to a denoiser whose output is not used, so that its
+// estimate converges before it processes anything audible
+static void replay_input(NoiseRepellentAdaptivePlugin *self,
+                         SpectralBleachHandle lib_instance,
+                         SpeechBand *speech_band, const float *samples,
+                         const uint32_t number_of_samples, float *scratch) {
+  for (uint32_t offset = 0U; offset < number_of_samples;
+       offset += self->block_length.maximum) {
+    uint32_t block_size = number_of_samples - offset;
+    if (block_size > self->block_length.maximum) {
+      block_size = self->block_length.maximum;
+    }
+
+    run_denoiser(lib_instance, speech_band, block_size, &samples[offset],
+                 scratch, false);
+  }
+}
+
+// Output turns dry at once and stays so for two latency periods, so that audio
+// replayed or left in the STFT buffers of another denoiser is never heard
+static void start_warm_up(NoiseRepellentAdaptivePlugin *self) {
+  signal_crossfade_cut_to_dry(self->soft_bypass);
+  self->denoiser_bypassed = true;
+  self->warmup_samples = 0U;
+}
+
+// Builds the denoisers of the requested mode outside the audio thread and
+// warms them up with the recent input
+static bool create_instances(NoiseRepellentAdaptivePlugin *self,
+                             LatencyWork *work) {
+  const uint32_t length = signal_history_get_length(self->input_histories[0]);
+  float *history = (float *)calloc(length, sizeof(float));
+  float *scratch = (float *)calloc(self->block_length.maximum, sizeof(float));
+  bool created = history && scratch;
+
+  for (uint32_t channel = 0U; created && channel < self->number_of_channels;
+       channel++) {
+    work->lib_instances[channel] =
+        create_denoiser(get_denoiser_rate(self, work));
+    if (!work->lib_instances[channel]) {
+      created = false;
+      break;
+    }
+
+    if (work->speech_band) {
+      work->speech_bands[channel] = speech_band_initialize(
+          self->block_length.maximum,
+          specbleach_adaptive_get_latency(work->lib_instances[channel]));
+      if (!work->speech_bands[channel]) {
+        created = false;
+        break;
+      }
+    }
+
+    const uint32_t history_size =
+        signal_history_read(self->input_histories[channel], history);
+    replay_input(self, work->lib_instances[channel],
+                 work->speech_bands[channel], &history[length - history_size],
+                 history_size, scratch);
+  }
+
+  free(history);
+  free(scratch);
+
+  if (!created) {
+    free_instances(work->lib_instances, work->speech_bands);
+  }
+
+  return created;
+}
+
+// Applied between cycles, the replaced denoisers are handed back in the work
+// message so they can be freed elsewhere
+static void swap_instances(NoiseRepellentAdaptivePlugin *self,
+                           LatencyWork *work) {
+  for (uint32_t channel = 0U; channel < 2U; channel++) {
+    SpectralBleachHandle replaced = self->lib_instances[channel];
+    self->lib_instances[channel] = work->lib_instances[channel];
+    work->lib_instances[channel] = replaced;
+
+    SpeechBand *replaced_band = self->speech_bands[channel];
+    self->speech_bands[channel] = work->speech_bands[channel];
+    work->speech_bands[channel] = replaced_band;
+  }
+
+  self->latency =
+      self->speech_bands[0]
+          ? speech_band_get_latency(self->speech_bands[0])
+          : specbleach_adaptive_get_latency(self->lib_instances[0]);
+  const uint32_t fade_length =
+      (uint32_t)(DELAY_FADE_MS * self->sample_rate / 1000.F);
+  for (uint32_t channel = 0U; channel < self->number_of_channels; channel++) {
+    delay_line_fade_to_delay(self->delay_lines[channel], self->latency,
+                             fade_length);
+    silence_gate_reset(self->silence_gates[channel], self->latency);
+  }
+  self->parameters_pending = true;
+  start_warm_up(self);
+}
+
+static bool schedule_work(NoiseRepellentAdaptivePlugin *self,
+                          const LatencyWork *work) {
+  return self->schedule &&
+         self->schedule->schedule_work(self->schedule->handle,
+                                       sizeof(LatencyWork),
+                                       work) == LV2_WORKER_SUCCESS;
+}
+
+// Hosts read the latency port after every cycle, so a new mode is announced
+// as soon as its denoisers are in place. Building them is never done on the
+// audio thread, so without a worker the mode stays as it is
+static void update_latency(NoiseRepellentAdaptivePlugin *self) {
+  const bool speech_band =
+      self->speech_band && self->schedule ? (bool)*self->speech_band : false;
+
+  if (speech_band != self->speech_band_requested ||
+      self->warm_start_pending) {
+    LatencyWork work = {WORK_SWITCH_LATENCY, speech_band, {NULL, NULL},
+                        {NULL, NULL}};
+
+    // A full queue leaves the request pending for the next cycle
+    if (schedule_work(self, &work)) {
+      self->speech_band_requested = speech_band;
+      self->warm_start_pending = false;
+    }
+  }
+
+  *self->report_latency = (float)self->latency;
+}
+
+// Switches apply right away while continuous controls glide to their new
+// value. The denoiser only reloads its parameters when one of them moved,
+// which happens at most once per control period
+static void update_parameters(NoiseRepellentAdaptivePlugin *self,
+                              const uint32_t number_of_samples) {
+  const float targets[NUMBER_OF_SMOOTHED_CONTROLS] = {
+      [SMOOTHED_REDUCTION_AMOUNT] = *self->reduction_amount,
+      [SMOOTHED_NOISE_RESCALE] = *self->noise_rescale,
+      [SMOOTHED_SMOOTHING_FACTOR] = *self->smoothing_factor,
+  };
+  const bool residual_listen = (bool)*self->residual_listen;
+
+  const bool gliding =
+      control_smoother_run(self->control_smoother, targets, number_of_samples);
+
+  if (!gliding && residual_listen == self->parameters.residual_listen) {
+    return;
+  }
+
+  const float *values = control_smoother_get_values(self->control_smoother);
 
   // clang-format off
   self->parameters = (SpectralBleachParameters){
-      .residual_listen = (bool)*self->residual_listen,
-      .reduction_amount = *self->reduction_amount,
-      .smoothing_factor = *self->smoothing_factor,
-      .noise_rescale = *self->noise_rescale
+      .residual_listen = residual_listen,
+      .reduction_amount = values[SMOOTHED_REDUCTION_AMOUNT],
+      .smoothing_factor = values[SMOOTHED_SMOOTHING_FACTOR],
+      .noise_rescale = values[SMOOTHED_NOISE_RESCALE]
   };
   // clang-format on
 
-  specbleach_adaptive_load_parameters(self->lib_instance_1, self->parameters);
+  self->parameters_pending = true;
+}
+
+static void process_instance(NoiseRepellentAdaptivePlugin *self,
+                             SpectralBleachHandle lib_instance,
+                             SpeechBand *speech_band, SilenceGate *silence_gate,
+                             const float *input, float *output) {
+  if (self->parameters_pending) {
+    specbleach_adaptive_load_parameters(lib_instance, self->parameters);
+  }
+
+  // Skipping silence also keeps the noise estimate from decaying towards it
+  if (silence_gate_run(silence_gate, self->number_of_samples, input)) {
+    memset(output, 0, sizeof(float) * self->number_of_samples);
+    return;
+  }
+
+  run_denoiser(lib_instance, speech_band, self->number_of_samples, input,
+               output, self->parameters.residual_listen);
+}
+
+static void process_channel(void *data, const uint32_t channel) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)data;
+
+  signal_history_write(self->input_histories[channel], self->number_of_samples,
+                       self->block_inputs[channel]);
+
+  process_instance(self, self->lib_instances[channel],
+                   self->speech_bands[channel], self->silence_gates[channel],
+                   self->block_inputs[channel], self->block_outputs[channel]);
+}
+
+static bool is_output_buffer(const float *input,
+                             const uint32_t number_of_channels,
+                             float *const *outputs) {
+  for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+    if (input == outputs[channel]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Hosts processing in place overwrite the input, so it is kept aside for the
+// crossfade before the denoiser writes the output. The buffer may be shared
+// with the output of any channel, not only with its own
+static void keep_dry_signals(NoiseRepellentAdaptivePlugin *self,
+                             const uint32_t number_of_channels,
+                             const float *const *inputs, float *const *outputs,
+                             const float **dry_signals) {
+  for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+    dry_signals[channel] = inputs[channel];
+    if (is_output_buffer(inputs[channel], number_of_channels, outputs)) {
+      memcpy(self->dry_signals[channel], inputs[channel],
+             sizeof(float) * self->number_of_samples);
+      dry_signals[channel] = self->dry_signals[channel];
+    }
+  }
+}
+
+// The denoiser is skipped entirely once the fade to dry has converged
+static bool skip_denoiser(NoiseRepellentAdaptivePlugin *self) {
+  const bool enable = (bool)*self->enable;
+
+  if (!enable && signal_crossfade_is_dry(self->soft_bypass)) {
+    self->denoiser_bypassed = true;
+    self->warmup_samples = 0U;
+  }
+
+  return self->denoiser_bypassed && !enable;
+}
+
+// After being skipped the denoiser is fed during two latency periods before
+// the fade starts. Frames from before the bypass leave the analysis window
+// after one, but stay in the overlap-add output for another
+static bool soft_bypass_enabled(NoiseRepellentAdaptivePlugin *self) {
+  if (!self->denoiser_bypassed) {
+    return (bool)*self->enable;
+  }
+
+  self->warmup_samples += self->number_of_samples;
+  if (self->warmup_samples >= 2U * self->latency) {
+    self->denoiser_bypassed = false;
+  }
+
+  return false;
+}
+
+// Monitoring outputs are optional, nothing is measured when none is connected
+static bool monitoring_enabled(const NoiseRepellentAdaptivePlugin *self) {
+  return self->cycle_time || self->peak_cycle_time || self->mean_reduction;
+}
+
+static void measure_reduction(NoiseRepellentAdaptivePlugin *self,
+                              const uint32_t number_of_channels,
+                              const float *const *inputs,
+                              float *const *outputs) {
+  if (self->mean_reduction) {
+    processing_monitor_measure_reduction(
+        self->processing_monitor, self->number_of_samples, number_of_channels,
+        inputs, (const float *const *)outputs);
+  }
+}
+
+static void report_monitoring(NoiseRepellentAdaptivePlugin *self) {
+  if (self->cycle_time) {
+    *self->cycle_time =
+        processing_monitor_get_cycle_time(self->processing_monitor);
+  }
+  if (self->peak_cycle_time) {
+    *self->peak_cycle_time =
+        processing_monitor_get_peak_cycle_time(self->processing_monitor);
+  }
+  if (self->mean_reduction) {
+    *self->mean_reduction =
+        processing_monitor_get_reduction(self->processing_monitor);
+  }
+}
+
+static void delay_dry_signals(NoiseRepellentAdaptivePlugin *self,
+                              const uint32_t number_of_channels,
+                              const float *const *dry_signals,
+                              float *const *delayed_signals) {
+  for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+    delay_line_run(self->delay_lines[channel], self->number_of_samples,
+                   dry_signals[channel], delayed_signals[channel]);
+  }
+}
+
+// The helper thread is always used while the host renders offline
+static bool parallel_enabled(const NoiseRepellentAdaptivePlugin *self) {
+  return (self->parallel && (bool)*self->parallel) ||
+         (self->free_wheeling && (bool)*self->free_wheeling);
+}
+
+static void process_block(NoiseRepellentAdaptivePlugin *self,
+                          const uint32_t number_of_channels,
+                          const float *const *inputs, float *const *outputs) {
+  const float *dry_signals[2] = {NULL, NULL};
+  keep_dry_signals(self, number_of_channels, inputs, outputs, dry_signals);
+
+  // Bypassed output is the input delayed as much as the denoiser output
+  if (skip_denoiser(self)) {
+    delay_dry_signals(self, number_of_channels, dry_signals, outputs);
+    measure_reduction(self, number_of_channels,
+                      (const float *const *)outputs, outputs);
+    return;
+  }
+
+  delay_dry_signals(self, number_of_channels, dry_signals,
+                    self->delayed_signals);
+
+  // The denoiser reads the kept copy, so it never reads a buffer it writes
+  self->block_inputs = dry_signals;
+  self->block_outputs = outputs;
+
+  // Both channels are independent, so a helper can take one of them when no
+  // other instance holds them all
+  if (!(number_of_channels == 2U && parallel_enabled(self) &&
+        processing_pool_run(self->processing_pool, 2U, process_channel,
+                            self))) {
+    for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+      process_channel(self, channel);
+    }
+  }
+  self->parameters_pending = false;
+
+  signal_crossfade_run(self->soft_bypass, self->number_of_samples,
+                       number_of_channels,
+                       (const float *const *)self->delayed_signals, outputs,
+                       soft_bypass_enabled(self));
+
+  measure_reduction(self, number_of_channels,
+                    (const float *const *)self->delayed_signals, outputs);
+}
+
+// Blocks longer than the announced maximum are split to fit the scratch memory
+static void process_blocks(NoiseRepellentAdaptivePlugin *self,
+                           const uint32_t number_of_samples,
+                           const uint32_t number_of_channels) {
+  const float *ports_inputs[2] = {self->input_1, self->input_2};
+  float *ports_outputs[2] = {self->output_1, self->output_2};
+  const bool monitoring = monitoring_enabled(self);
+
+  if (monitoring) {
+    processing_monitor_start_cycle(self->processing_monitor);
+  }
+
+  for (uint32_t offset = 0U; offset < number_of_samples;
+       offset += self->number_of_samples) {
+    self->number_of_samples = number_of_samples - offset;
+    if (self->number_of_samples > self->block_length.maximum) {
+      self->number_of_samples = self->block_length.maximum;
+    }
+    const uint32_t samples_to_step =
+        control_smoother_get_samples_to_step(self->control_smoother);
+    if (self->number_of_samples > samples_to_step) {
+      self->number_of_samples = samples_to_step;
+    }
+
+    const float *inputs[2] = {NULL, NULL};
+    float *outputs[2] = {NULL, NULL};
+    for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+      inputs[channel] = &ports_inputs[channel][offset];
+      outputs[channel] = &ports_outputs[channel][offset];
+    }
+
+    process_block(self, number_of_channels, inputs, outputs);
+    update_parameters(self, self->number_of_samples);
+  }
+
+  if (monitoring) {
+    processing_monitor_end_cycle(self->processing_monitor, number_of_samples);
+    report_monitoring(self);
+  }
+}
+
+// Input goes straight to the output until the denoisers exist
+static bool pass_through_uninitialized(NoiseRepellentAdaptivePlugin *self,
+                                       const uint32_t number_of_samples,
+                                       const uint32_t number_of_channels) {
+  if (self->denoisers_ready) {
+    return false;
+  }
 
-  specbleach_adaptive_process(self->lib_instance_1, number_of_samples,
-                              self->input_1, self->output_1);
+  const float *inputs[2] = {self->input_1, self->input_2};
+  float *outputs[2] = {self->output_1, self->output_2};
+  for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+    if (inputs[channel] != outputs[channel]) {
+      memcpy(outputs[channel], inputs[channel],
+             sizeof(float) * number_of_samples);
+    }
+  }
 
-  signal_crossfade_run(self->soft_bypass, number_of_samples, self->input_1,
-                       self->output_1, (bool)*self->enable);
+  return true;
+}
+
+static void run(LV2_Handle instance, uint32_t number_of_samples) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+
+  if (pass_through_uninitialized(self, number_of_samples, 1U)) {
+    return;
+  }
+
+  update_latency(self);
+  update_parameters(self, 0U);
+
+  process_blocks(self, number_of_samples, 1U);
 }
 
 static void run_stereo(LV2_Handle instance, uint32_t number_of_samples) {
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
 
-  run(instance, number_of_samples); // Call left side first
+  if (pass_through_uninitialized(self, number_of_samples, 2U)) {
+    return;
+  }
 
-  specbleach_adaptive_load_parameters(self->lib_instance_2, self->parameters);
+  update_latency(self);
+  update_parameters(self, 0U);
 
-  specbleach_adaptive_process(self->lib_instance_2, number_of_samples,
-                              self->input_2, self->output_2);
+  process_blocks(self, number_of_samples, 2U);
+}
+
+// Program audio only ends up in the session when warm start was asked for
+static bool warm_start_enabled(const NoiseRepellentAdaptivePlugin *self) {
+  return self->warm_start && (bool)*self->warm_start;
+}
+
+static LV2_State_Status save(LV2_Handle instance,
+                             LV2_State_Store_Function store,
+                             LV2_State_Handle handle, uint32_t flags,
+                             const LV2_Feature *const *features) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+
+  if (!self->denoisers_ready || !warm_start_enabled(self)) {
+    return LV2_STATE_SUCCESS;
+  }
+
+  // Blocks written while a channel is read are left out of its history, so
+  // only as many samples as the shortest one holds are kept
+  uint32_t history_size = UINT32_MAX;
+  for (uint32_t channel = 0U; channel < self->number_of_channels; channel++) {
+    const uint32_t channel_size = signal_history_read(
+        self->input_histories[channel],
+        noise_profile_get_elements(self->input_history_states[channel]));
+    if (channel_size < history_size) {
+      history_size = channel_size;
+    }
+  }
+
+  if (history_size == 0U) {
+    return LV2_STATE_SUCCESS;
+  }
+
+  store(handle, self->state.property_input_history_size, &history_size,
+        sizeof(uint32_t), self->uris.atom_Int,
+        LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+
+  for (uint32_t channel = 0U; channel < self->number_of_channels; channel++) {
+    NoiseProfileState *history_state = self->input_history_states[channel];
+    store(handle, self->state.property_input_histories[channel],
+          noise_profile_get_body(history_state),
+          noise_profile_get_size(history_state), self->uris.atom_Vector,
+          LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+  }
+
+  return LV2_STATE_SUCCESS;
+}
+
+static LV2_State_Status restore(LV2_Handle instance,
+                                LV2_State_Retrieve_Function retrieve,
+                                LV2_State_Handle handle, uint32_t flags,
+                                const LV2_Feature *const *features) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+
+  size_t size = 0U;
+  uint32_t type = 0U;
+  uint32_t valflags = 0U;
+
+  // Histories only exist once the denoisers do, but their length is known
+  const uint32_t length = get_history_length(self);
+
+  const uint32_t *history_size = (const uint32_t *)retrieve(
+      handle, self->state.property_input_history_size, &size, &type, &valflags);
+  if (history_size == NULL || type != self->uris.atom_Int ||
+      *history_size > length) {
+    return LV2_STATE_ERR_NO_PROPERTY;
+  }
 
-  signal_crossfade_run(self->soft_bypass, number_of_samples, self->input_2,
-                       self->output_2, (bool)*self->enable);
+  // Histories saved at another sample rate have another length and are
+  // ignored, the denoiser then starts cold as before
+  const float *saved_elements[2] = {NULL, NULL};
+  for (uint32_t channel = 0U; channel < self->number_of_channels; channel++) {
+    const void *saved_history =
+        retrieve(handle, self->state.property_input_histories[channel], &size,
+                 &type, &valflags);
+    saved_elements[channel] =
+        noise_profile_state_read(saved_history, size, length);
+    if (!saved_elements[channel] || type != self->uris.atom_Vector) {
+      return LV2_STATE_ERR_NO_PROPERTY;
+    }
+  }
+
+  if (!initialize_denoisers(self)) {
+    return LV2_STATE_ERR_UNKNOWN;
+  }
+
+  // Saved samples sit at the end of each history
+  for (uint32_t channel = 0U; channel < self->number_of_channels; channel++) {
+    signal_history_load(self->input_histories[channel], *history_size,
+                        &saved_elements[channel][length - *history_size]);
+  }
+
+  // Replaying takes a while, so the next cycle asks the worker to build warm
+  // denoisers from the history and swap them in. Without a worker the
+  // denoisers start cold
+  self->warm_start_pending = self->schedule != NULL;
+
+  return LV2_STATE_SUCCESS;
+}
+
+static LV2_Worker_Status work(LV2_Handle instance,
+                              LV2_Worker_Respond_Function respond,
+                              LV2_Worker_Respond_Handle handle, uint32_t size,
+                              const void *data) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+
+  if (size != sizeof(LatencyWork)) {
+    return LV2_WORKER_ERR_UNKNOWN;
+  }
+
+  LatencyWork latency_work;
+  memcpy(&latency_work, data, sizeof(LatencyWork));
+
+  switch ((WorkType)latency_work.type) {
+  case WORK_SWITCH_LATENCY:
+    if (!create_instances(self, &latency_work)) {
+      lv2_log_error(&self->log, "Error switching latency of <%s>\n",
+                    self->plugin_uri);
+      return LV2_WORKER_ERR_UNKNOWN;
+    }
+    return respond(handle, sizeof(LatencyWork), &latency_work);
+  case WORK_FREE_INSTANCES:
+    free_instances(latency_work.lib_instances, latency_work.speech_bands);
+    break;
+  default:
+    break;
+  }
+
+  return LV2_WORKER_SUCCESS;
+}
+
+static LV2_Worker_Status work_response(LV2_Handle instance, uint32_t size,
+                                       const void *data) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+
+  if (size != sizeof(LatencyWork)) {
+    return LV2_WORKER_ERR_UNKNOWN;
+  }
+
+  LatencyWork latency_work;
+  memcpy(&latency_work, data, sizeof(LatencyWork));
+
+  if ((WorkType)latency_work.type == WORK_SWITCH_LATENCY) {
+    swap_instances(self, &latency_work);
+
+    latency_work.type = WORK_FREE_INSTANCES;
+    if (!schedule_work(self, &latency_work)) {
+      free_instances(latency_work.lib_instances, latency_work.speech_bands);
+    }
+  }
+
+  return LV2_WORKER_SUCCESS;
+}
+
+static const void *extension_data(const char *uri) {
+  static const LV2_State_Interface state = {save, restore};
+  static const LV2_Worker_Interface worker = {work, work_response, NULL};
+  if (strcmp(uri, LV2_STATE__interface) == 0) {
+    return &state;
+  }
+  if (strcmp(uri, LV2_WORKER__interface) == 0) {
+    return &worker;
+  }
+  return NULL;
 }
 
 // clang-format off
 static const LV2_Descriptor descriptor_adaptive = {
     NOISEREPELLENT_ADAPTIVE_URI,
     instantiate,
-    connect_port,
+    connect_port_mono,
     activate,
     run,
     NULL,
     cleanup,
-    NULL
+    extension_data
 };
 
 static const LV2_Descriptor descriptor_adaptive_stereo = {
@@ -281,7 +1180,7 @@ static const LV2_Descriptor descriptor_adaptive_stereo = {
     run_stereo,
     NULL,
     cleanup,
-    NULL
+    extension_data
 };
 // clang-format on
 
@@ -18,22 +18,61 @@ along with this program; if not, write to the Free Software Foundation,
 Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
+#include "../src/block_length.h"
+#include "../src/control_smoother.h"
+#include "../src/delay_line.h"
+#include "../src/memory_arena.h"
 #include "../src/noise_profile_state.h"
+#include "../src/planner_lock.h"
+#include "../src/processing_monitor.h"
+#include "../src/processing_pool.h"
+#include "../src/profile_resampler.h"
+#include "../src/profile_store.h"
 #include "../src/signal_crossfade.h"
+#include "../src/silence_gate.h"
 
 #include "lv2/atom/atom.h"
 #include "lv2/core/lv2.h"
 #include "lv2/core/lv2_util.h"
 #include "lv2/log/logger.h"
+#include "lv2/options/options.h"
 #include "lv2/state/state.h"
 #include "lv2/urid/urid.h"
+#include "lv2/worker/worker.h"
+#include "nrepellent_batch.h"
 #include "specbleach_denoiser.h"
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define NOISEREPELLENT_URI "https://github.com/lucianodato/noise-repellent#new"
 #define NOISEREPELLENT_STEREO_URI                                              \
   "https://github.com/lucianodato/noise-repellent-stereo#new"
+#define NOISEREPELLENT_STEREO_LINKED_URI                                       \
+  "https://github.com/lucianodato/noise-repellent-stereo#linked"
+#define NOISEREPELLENT_MULTICHANNEL_URI                                        \
+  "https://github.com/lucianodato/noise-repellent-multichannel"
+
+#define MAX_CHANNELS 16U
+#define MAX_STATE_KEY_SIZE 256U
+
+// Channel layouts offered for surround stems and ambisonics
+typedef struct MultichannelVariant {
+  const char *uri;
+  uint32_t number_of_channels;
+} MultichannelVariant;
+
+static const MultichannelVariant multichannel_variants[] = {
+    {NOISEREPELLENT_MULTICHANNEL_URI "#4ch", 4U},
+    {NOISEREPELLENT_MULTICHANNEL_URI "#6ch", 6U},
+    {NOISEREPELLENT_MULTICHANNEL_URI "#8ch", 8U},
+    {NOISEREPELLENT_MULTICHANNEL_URI "#12ch", 12U},
+    {NOISEREPELLENT_MULTICHANNEL_URI "#16ch", 16U},
+};
+
+#define NUMBER_OF_MULTICHANNEL_VARIANTS                                        \
+  (sizeof(multichannel_variants) / sizeof(multichannel_variants[0]))
 
 typedef struct URIs {
   LV2_URID atom_Int;
@@ -44,10 +83,10 @@ typedef struct URIs {
 } URIs;
 
 typedef struct State {
-  LV2_URID property_noise_profile_1;
-  LV2_URID property_noise_profile_2;
+  LV2_URID property_noise_profiles[MAX_CHANNELS];
   LV2_URID property_noise_profile_size;
   LV2_URID property_averaged_blocks;
+  LV2_URID property_sample_rate;
 } State;
 
 static void map_uris(LV2_URID_Map *map, URIs *uris, const char *uri) {
@@ -60,27 +99,91 @@ static void map_uris(LV2_URID_Map *map, URIs *uris, const char *uri) {
   uris->atom_URID = map->map(map->handle, LV2_ATOM__URID);
 }
 
-static void map_state(LV2_URID_Map *map, State *state, const char *uri) {
-  if (!strcmp(uri, NOISEREPELLENT_URI)) {
-    state->property_noise_profile_1 =
-        map->map(map->handle, NOISEREPELLENT_STEREO_URI "#noiseprofile");
-    state->property_noise_profile_2 =
+// Every channel with its own profile stores it under a numbered key, the
+// first one keeps the key used before there was more than one
+static void map_multichannel_state(LV2_URID_Map *map, State *state,
+                                   const char *uri,
+                                   const uint32_t number_of_profiles) {
+  char key[MAX_STATE_KEY_SIZE];
+
+  for (uint32_t k = 0U; k < number_of_profiles; k++) {
+    if (k == 0U) {
+      snprintf(key, sizeof(key), "%s#noiseprofile", uri);
+    } else {
+      snprintf(key, sizeof(key), "%s#noiseprofile%u", uri,
+               (unsigned int)k + 1U);
+    }
+    state->property_noise_profiles[k] = map->map(map->handle, key);
+  }
+
+  snprintf(key, sizeof(key), "%s#noiseprofilesize", uri);
+  state->property_noise_profile_size = map->map(map->handle, key);
+  snprintf(key, sizeof(key), "%s#noiseprofileaveragedblocks", uri);
+  state->property_averaged_blocks = map->map(map->handle, key);
+  snprintf(key, sizeof(key), "%s#noiseprofilesamplerate", uri);
+  state->property_sample_rate = map->map(map->handle, key);
+}
+
+static void map_state(LV2_URID_Map *map, State *state, const char *uri,
+                      const uint32_t number_of_profiles) {
+  if (strstr(uri, NOISEREPELLENT_MULTICHANNEL_URI)) {
+    map_multichannel_state(map, state, uri, number_of_profiles);
+
+  } else if (!strcmp(uri, NOISEREPELLENT_STEREO_LINKED_URI)) {
+    state->property_noise_profiles[0] =
+        map->map(map->handle, NOISEREPELLENT_STEREO_LINKED_URI "#noiseprofile");
+    state->property_noise_profile_size = map->map(
+        map->handle, NOISEREPELLENT_STEREO_LINKED_URI "#noiseprofilesize");
+    state->property_averaged_blocks =
+        map->map(map->handle,
+                 NOISEREPELLENT_STEREO_LINKED_URI "#noiseprofileaveragedblocks");
+    state->property_sample_rate =
+        map->map(map->handle,
+                 NOISEREPELLENT_STEREO_LINKED_URI "#noiseprofilesamplerate");
+
+  } else if (!strcmp(uri, NOISEREPELLENT_URI)) {
+    state->property_noise_profiles[0] =
         map->map(map->handle, NOISEREPELLENT_STEREO_URI "#noiseprofile");
     state->property_noise_profile_size =
         map->map(map->handle, NOISEREPELLENT_STEREO_URI "#noiseprofilesize");
     state->property_averaged_blocks = map->map(
         map->handle, NOISEREPELLENT_STEREO_URI "#noiseprofileaveragedblocks");
+    state->property_sample_rate = map->map(
+        map->handle, NOISEREPELLENT_STEREO_URI "#noiseprofilesamplerate");
 
   } else {
-    state->property_noise_profile_1 =
+    state->property_noise_profiles[0] =
         map->map(map->handle, NOISEREPELLENT_URI "#noiseprofile");
+    state->property_noise_profiles[1] =
+        map->map(map->handle, NOISEREPELLENT_URI "#noiseprofile2");
     state->property_noise_profile_size =
         map->map(map->handle, NOISEREPELLENT_URI "#noiseprofilesize");
     state->property_averaged_blocks =
         map->map(map->handle, NOISEREPELLENT_URI "#noiseprofileaveragedblocks");
+    state->property_sample_rate =
+        map->map(map->handle, NOISEREPELLENT_URI "#noiseprofilesamplerate");
   }
 }
 
+typedef enum WorkType {
+  WORK_LOAD_NOISE_PROFILE = 0,
+  WORK_LINK_NOISE_PROFILES = 2,
+  WORK_PUBLISH_NOISE_PROFILE = 3,
+  WORK_FETCH_NOISE_PROFILE = 4,
+} WorkType;
+
+// Each job carries what it hands back, so replies still queued never see what
+// a later job left. Jobs scheduled before a restore come back stale
+typedef struct WorkMessage {
+  uint32_t type;
+  uint32_t generation;
+  uint32_t version;
+  const SharedProfile *profile;
+} WorkMessage;
+
+// Most jobs one cycle schedules, one for the profile slot and one for linking
+#define MAX_DEFERRED_WORK 2U
+
 typedef enum PortIndex {
   NOISEREPELLENT_AMOUNT = 0,
   NOISEREPELLENT_NOISE_OFFSET = 1,
@@ -96,31 +199,93 @@ typedef enum PortIndex {
   NOISEREPELLENT_OUTPUT_1 = 11,
   NOISEREPELLENT_INPUT_2 = 12,
   NOISEREPELLENT_OUTPUT_2 = 13,
+  NOISEREPELLENT_PARALLEL = 14,
 } PortIndex;
 
+// Monitoring outputs come after the last port of each variant
+typedef enum MonitorPortIndex {
+  NOISEREPELLENT_CYCLE_TIME = 0,
+  NOISEREPELLENT_PEAK_CYCLE_TIME = 1,
+  NOISEREPELLENT_LEARNED_BLOCKS = 2,
+  NOISEREPELLENT_MEAN_REDUCTION = 3,
+} MonitorPortIndex;
+
+#define MONO_MONITOR_PORTS_START 12U
+#define STEREO_MONITOR_PORTS_START 15U
+
+// Added after the last port to keep the indices of existing ports
+#define MONO_FREE_WHEELING_PORT 16U
+#define STEREO_FREE_WHEELING_PORT 19U
+#define MONO_PROFILE_SLOT_PORT 17U
+#define STEREO_PROFILE_SLOT_PORT 20U
+
+// Multichannel variants share the mono controls and place the audio ports
+// last, one input and output pair per channel
+#define MULTICHANNEL_PARALLEL_PORT 10U
+#define MULTICHANNEL_MONITOR_PORTS_START 11U
+#define MULTICHANNEL_AUDIO_PORTS_START 15U
+
+typedef enum SmoothedControl {
+  SMOOTHED_REDUCTION_AMOUNT = 0,
+  SMOOTHED_NOISE_RESCALE = 1,
+  SMOOTHED_SMOOTHING_FACTOR = 2,
+  SMOOTHED_WHITENING_FACTOR = 3,
+  NUMBER_OF_SMOOTHED_CONTROLS = 4,
+} SmoothedControl;
+
 typedef struct NoiseRepellentPlugin {
-  const float *input_1;
-  const float *input_2;
-  float *output_1;
-  float *output_2;
+  const float *inputs[MAX_CHANNELS];
+  float *outputs[MAX_CHANNELS];
+  uint32_t number_of_channels;
   float sample_rate;
   float *report_latency;
 
   LV2_URID_Map *map;
   LV2_Log_Logger log;
+  LV2_Worker_Schedule *schedule;
   URIs uris;
   State state;
   char *plugin_uri;
 
   SignalCrossfade *soft_bypass;
-  SpectralBleachHandle lib_instance_1;
-  SpectralBleachHandle lib_instance_2;
+  ProcessingPool *processing_pool;
+  ProcessingMonitor *processing_monitor;
+  BlockLength block_length;
+  MemoryArena *memory_arena;
+  float *dry_signals[MAX_CHANNELS];
+  float *delayed_signals[MAX_CHANNELS];
+  DelayLine *delay_lines[MAX_CHANNELS];
+  SilenceGate *silence_gates[MAX_CHANNELS];
+  const float *const *block_inputs;
+  float *const *block_outputs;
+  uint32_t number_of_samples;
+  SpectralBleachHandle lib_instances[MAX_CHANNELS];
   SpectralBleachParameters parameters;
-  NoiseProfileState *noise_profile_state_1;
-  NoiseProfileState *noise_profile_state_2;
-  float *noise_profile_1;
-  float *noise_profile_2;
+  ControlSmoother *control_smoother;
+  bool parameters_pending;
+  float *noise_profiles[MAX_CHANNELS];
+  uint32_t number_of_profiles;
   uint32_t profile_size;
+  uint32_t latency;
+  uint32_t captured_averaged_blocks;
+  uint32_t profile_generation;
+  float *link_snapshots[2];
+  uint32_t link_averaged_blocks;
+  bool link_requested;
+  bool link_pending;
+  bool learning;
+  bool resetting;
+  uint32_t profile_slot_index;
+  uint32_t profile_slot_version;
+  bool profile_slot_busy;
+  bool publish_pending;
+  bool profile_store_acquired;
+  bool denoisers_ready;
+  bool denoiser_bypassed;
+  uint32_t warmup_samples;
+  WorkMessage deferred_work[MAX_DEFERRED_WORK];
+  uint32_t number_of_deferred_work;
+  bool deferring_work;
 
   float *enable;
   float *learn_noise;
@@ -131,34 +296,57 @@ typedef struct NoiseRepellentPlugin {
   float *whitening_factor;
   float *noise_rescale;
   float *reset_noise_profile;
+  float *parallel;
+  float *free_wheeling;
+  float *profile_slot;
+
+  float *cycle_time;
+  float *peak_cycle_time;
+  float *learned_blocks;
+  float *mean_reduction;
 
 } NoiseRepellentPlugin;
 
 static void cleanup(LV2_Handle instance) {
   NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
 
-  if (self->noise_profile_state_1) {
-    noise_profile_state_free(self->noise_profile_state_1);
-    free(self->noise_profile_1);
-  }
+  processing_pool_release(self->processing_pool);
+
+  for (uint32_t channel = 0U; channel < MAX_CHANNELS; channel++) {
+    if (self->lib_instances[channel]) {
+      planner_lock_acquire();
+      specbleach_free(self->lib_instances[channel]);
+      planner_lock_release();
+    }
 
-  if (self->lib_instance_1) {
-    specbleach_free(self->lib_instance_1);
+    if (self->delay_lines[channel]) {
+      delay_line_free(self->delay_lines[channel]);
+    }
+    if (self->silence_gates[channel]) {
+      silence_gate_free(self->silence_gates[channel]);
+    }
   }
 
-  if (self->noise_profile_state_2) {
-    noise_profile_state_free(self->noise_profile_state_2);
-    free(self->noise_profile_2);
+  if (self->memory_arena) {
+    memory_arena_free(self->memory_arena);
   }
 
-  if (self->lib_instance_2) {
-    specbleach_free(self->lib_instance_2);
+  if (self->profile_store_acquired) {
+    profile_store_release();
   }
 
   if (self->plugin_uri) {
     free(self->plugin_uri);
   }
 
+  if (self->control_smoother) {
+    control_smoother_free(self->control_smoother);
+  }
+
+  if (self->processing_monitor) {
+    processing_monitor_free(self->processing_monitor);
+  }
+
   if (self->soft_bypass) {
     signal_crossfade_free(self->soft_bypass);
   }
@@ -166,17 +354,130 @@ static void cleanup(LV2_Handle instance) {
   free(instance);
 }
 
+static void select_channels(NoiseRepellentPlugin *self) {
+  self->number_of_channels = 1U;
+  self->number_of_profiles = 1U;
+
+  if (!strcmp(self->plugin_uri, NOISEREPELLENT_STEREO_URI)) {
+    self->number_of_channels = 2U;
+    self->number_of_profiles = 2U;
+  } else if (!strcmp(self->plugin_uri, NOISEREPELLENT_STEREO_LINKED_URI)) {
+    self->number_of_channels = 2U;
+  }
+
+  for (uint32_t i = 0U; i < NUMBER_OF_MULTICHANNEL_VARIANTS; i++) {
+    if (!strcmp(self->plugin_uri, multichannel_variants[i].uri)) {
+      self->number_of_channels = multichannel_variants[i].number_of_channels;
+      self->number_of_profiles = multichannel_variants[i].number_of_channels;
+    }
+  }
+}
+
+static bool is_stereo_linked(const NoiseRepellentPlugin *self) {
+  return self->number_of_channels == 2U && self->number_of_profiles == 1U;
+}
+
+// Denoisers and everything sized after them are only built once the instance
+// is activated or restored, so hosts scanning or loading many instances that
+// stay off do not pay for them
+static bool initialize_denoisers(NoiseRepellentPlugin *self) {
+  if (self->denoisers_ready) {
+    return true;
+  }
+
+  // A failed attempt is not retried, cleanup frees whatever it left
+  if (self->lib_instances[0]) {
+    return false;
+  }
+
+  for (uint32_t channel = 0U; channel < self->number_of_channels; channel++) {
+    planner_lock_acquire();
+    self->lib_instances[channel] =
+        specbleach_initialize((uint32_t)self->sample_rate);
+    planner_lock_release();
+    if (!self->lib_instances[channel]) {
+      return false;
+    }
+  }
+
+  self->latency = specbleach_get_latency(self->lib_instances[0]);
+  self->profile_size =
+      specbleach_get_noise_profile_size(self->lib_instances[0]);
+  lv2_log_note(&self->log, "Saved Noise Repellent Profile Size <%u>\n",
+               (unsigned int)self->profile_size);
+
+  // Buffers touched on every cycle are carved from a single block, keeping
+  // the working set of an instance contiguous
+  const size_t dry_signal_size =
+      memory_arena_get_slice_size(self->block_length.maximum * sizeof(float));
+  const size_t noise_profile_size =
+      memory_arena_get_slice_size(self->profile_size * sizeof(float));
+  const uint32_t number_of_snapshots = is_stereo_linked(self) ? 2U : 0U;
+  self->memory_arena = memory_arena_initialize(
+      2U * self->number_of_channels * dry_signal_size +
+      (self->number_of_profiles + number_of_snapshots) * noise_profile_size);
+  if (!self->memory_arena) {
+    return false;
+  }
+
+#if defined(LOCK_MEMORY)
+  if (!memory_arena_lock(self->memory_arena)) {
+    lv2_log_note(&self->log, "Unable to lock memory of <%s>\n",
+                 self->plugin_uri);
+  }
+#endif
+
+  for (uint32_t channel = 0U; channel < self->number_of_channels; channel++) {
+    self->dry_signals[channel] = (float *)memory_arena_allocate(
+        self->memory_arena, self->block_length.maximum * sizeof(float));
+    self->delayed_signals[channel] = (float *)memory_arena_allocate(
+        self->memory_arena, self->block_length.maximum * sizeof(float));
+
+    self->delay_lines[channel] = delay_line_initialize(self->latency);
+    self->silence_gates[channel] = silence_gate_initialize(self->latency);
+    if (!self->delay_lines[channel] || !self->silence_gates[channel]) {
+      return false;
+    }
+  }
+
+  // Linked stereo shares the first profile between both channels
+  for (uint32_t k = 0U; k < self->number_of_profiles; k++) {
+    self->noise_profiles[k] = (float *)memory_arena_allocate(
+        self->memory_arena, self->profile_size * sizeof(float));
+  }
+  for (uint32_t k = 0U; k < number_of_snapshots; k++) {
+    self->link_snapshots[k] = (float *)memory_arena_allocate(
+        self->memory_arena, self->profile_size * sizeof(float));
+  }
+
+  // Channels are spread over the available cores, the calling thread being
+  // one of them
+  if (self->number_of_channels > 1U) {
+    self->processing_pool = processing_pool_acquire();
+    if (!self->processing_pool) {
+      lv2_log_note(&self->log, "Parallel processing unavailable for <%s>\n",
+                   self->plugin_uri);
+    }
+  }
+
+  self->denoisers_ready = true;
+  return true;
+}
+
 static LV2_Handle instantiate(const LV2_Descriptor *descriptor,
                               const double rate, const char *bundle_path,
                               const LV2_Feature *const *features) {
   NoiseRepellentPlugin *self =
       (NoiseRepellentPlugin *)calloc(1U, sizeof(NoiseRepellentPlugin));
+  const LV2_Options_Option *options = NULL;
 
   // clang-format off
   const char *missing =
       lv2_features_query(features,
                          LV2_LOG__log, &self->log.log, false,
                          LV2_URID__map, &self->map, true,
+                         LV2_WORKER__schedule, &self->schedule, false,
+                         LV2_OPTIONS__options, &options, false,
                          NULL);
   // clang-format on
 
@@ -188,57 +489,38 @@ static LV2_Handle instantiate(const LV2_Descriptor *descriptor,
     return NULL;
   }
 
-  if (strstr(descriptor->URI, NOISEREPELLENT_STEREO_URI)) {
-    self->plugin_uri =
-        (char *)calloc(strlen(NOISEREPELLENT_STEREO_URI) + 1U, sizeof(char));
-    strcpy(self->plugin_uri, descriptor->URI);
-  } else {
-    self->plugin_uri =
-        (char *)calloc(strlen(NOISEREPELLENT_URI) + 1U, sizeof(char));
-    strcpy(self->plugin_uri, descriptor->URI);
-  }
+  self->plugin_uri =
+      (char *)calloc(strlen(descriptor->URI) + 1U, sizeof(char));
+  strcpy(self->plugin_uri, descriptor->URI);
+
+  select_channels(self);
 
   map_uris(self->map, &self->uris, self->plugin_uri);
-  map_state(self->map, &self->state, self->plugin_uri);
+  map_state(self->map, &self->state, self->plugin_uri,
+            self->number_of_profiles);
 
   self->sample_rate = (float)rate;
 
-  self->soft_bypass = signal_crossfade_initialize((uint32_t)self->sample_rate);
+  // Scratch memory is sized once for the longest block the host may send
+  self->block_length = block_length_read_options(self->map, options);
+  lv2_log_note(&self->log, "Block length <%u> up to <%u>\n",
+               (unsigned int)self->block_length.nominal,
+               (unsigned int)self->block_length.maximum);
 
-  if (!self->soft_bypass) {
-    cleanup((LV2_Handle)self);
-    return NULL;
-  }
+  self->soft_bypass = signal_crossfade_initialize((uint32_t)self->sample_rate);
+  self->control_smoother = control_smoother_initialize(
+      NUMBER_OF_SMOOTHED_CONTROLS, (uint32_t)self->sample_rate);
+  self->processing_monitor =
+      processing_monitor_initialize((uint32_t)self->sample_rate);
 
-  self->lib_instance_1 = specbleach_initialize((uint32_t)self->sample_rate);
-  if (!self->lib_instance_1) {
-    lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
+  if (!self->soft_bypass || !self->control_smoother ||
+      !self->processing_monitor) {
     cleanup((LV2_Handle)self);
     return NULL;
   }
 
-  self->profile_size = specbleach_get_noise_profile_size(self->lib_instance_1);
-  lv2_log_note(&self->log, "Saved Noise Repellent Profile Size <%u>\n",
-               (unsigned int)self->profile_size);
-  self->noise_profile_state_1 =
-      noise_profile_state_initialize(self->uris.atom_Float);
-
-  self->noise_profile_1 = (float *)calloc(self->profile_size, sizeof(float));
-
-  if (strstr(self->plugin_uri, NOISEREPELLENT_STEREO_URI)) {
-    self->lib_instance_2 = specbleach_initialize((uint32_t)self->sample_rate);
-
-    if (!self->lib_instance_2) {
-      lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
-      cleanup((LV2_Handle)self);
-      return NULL;
-    }
-
-    self->noise_profile_state_2 =
-        noise_profile_state_initialize(self->uris.atom_Float);
-
-    self->noise_profile_2 = (float *)calloc(self->profile_size, sizeof(float));
-  }
+  profile_store_acquire();
+  self->profile_store_acquired = true;
 
   return (LV2_Handle)self;
 }
@@ -278,84 +560,698 @@ static void connect_port(LV2_Handle instance, uint32_t port, void *data) {
     self->report_latency = (float *)data;
     break;
   case NOISEREPELLENT_INPUT_1:
-    self->input_1 = (const float *)data;
+    self->inputs[0] = (const float *)data;
     break;
   case NOISEREPELLENT_OUTPUT_1:
-    self->output_1 = (float *)data;
+    self->outputs[0] = (float *)data;
+    break;
+  default:
+    break;
+  }
+}
+
+static void connect_monitor_port(NoiseRepellentPlugin *self,
+                                 const uint32_t port, void *data) {
+  switch ((MonitorPortIndex)port) {
+  case NOISEREPELLENT_CYCLE_TIME:
+    self->cycle_time = (float *)data;
+    break;
+  case NOISEREPELLENT_PEAK_CYCLE_TIME:
+    self->peak_cycle_time = (float *)data;
+    break;
+  case NOISEREPELLENT_LEARNED_BLOCKS:
+    self->learned_blocks = (float *)data;
+    break;
+  case NOISEREPELLENT_MEAN_REDUCTION:
+    self->mean_reduction = (float *)data;
     break;
   default:
     break;
   }
 }
 
+static void connect_port_mono(LV2_Handle instance, uint32_t port,
+                              void *data) {
+  NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
+
+  if (port == MONO_FREE_WHEELING_PORT) {
+    self->free_wheeling = (float *)data;
+    return;
+  }
+
+  if (port == MONO_PROFILE_SLOT_PORT) {
+    self->profile_slot = (float *)data;
+    return;
+  }
+
+  if (port >= MONO_MONITOR_PORTS_START) {
+    connect_monitor_port(self, port - MONO_MONITOR_PORTS_START, data);
+    return;
+  }
+
+  connect_port(instance, port, data);
+}
+
 static void connect_port_stereo(LV2_Handle instance, uint32_t port,
                                 void *data) {
   NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
 
+  if (port == STEREO_FREE_WHEELING_PORT) {
+    self->free_wheeling = (float *)data;
+    return;
+  }
+
+  if (port == STEREO_PROFILE_SLOT_PORT) {
+    self->profile_slot = (float *)data;
+    return;
+  }
+
+  if (port >= STEREO_MONITOR_PORTS_START) {
+    connect_monitor_port(self, port - STEREO_MONITOR_PORTS_START, data);
+    return;
+  }
+
   connect_port(instance, port, data);
 
   switch ((PortIndex)port) {
   case NOISEREPELLENT_INPUT_2:
-    self->input_2 = (const float *)data;
+    self->inputs[1] = (const float *)data;
     break;
   case NOISEREPELLENT_OUTPUT_2:
-    self->output_2 = (float *)data;
+    self->outputs[1] = (float *)data;
+    break;
+  case NOISEREPELLENT_PARALLEL:
+    self->parallel = (float *)data;
     break;
   default:
     break;
   }
 }
 
-static void activate(LV2_Handle instance) {
+static void connect_port_multichannel(LV2_Handle instance, uint32_t port,
+                                      void *data) {
   NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
 
-  *self->report_latency = (float)specbleach_get_latency(self->lib_instance_1);
+  const uint32_t last_audio_port =
+      MULTICHANNEL_AUDIO_PORTS_START + 2U * self->number_of_channels - 1U;
+  if (port == last_audio_port + 1U) {
+    self->free_wheeling = (float *)data;
+    return;
+  }
+
+  if (port == last_audio_port + 2U) {
+    self->profile_slot = (float *)data;
+    return;
+  }
+
+  if (port >= MULTICHANNEL_AUDIO_PORTS_START) {
+    const uint32_t channel = (port - MULTICHANNEL_AUDIO_PORTS_START) / 2U;
+    if (channel >= self->number_of_channels) {
+      return;
+    }
+
+    if ((port - MULTICHANNEL_AUDIO_PORTS_START) % 2U == 0U) {
+      self->inputs[channel] = (const float *)data;
+    } else {
+      self->outputs[channel] = (float *)data;
+    }
+    return;
+  }
+
+  if (port >= MULTICHANNEL_MONITOR_PORTS_START) {
+    connect_monitor_port(self, port - MULTICHANNEL_MONITOR_PORTS_START, data);
+    return;
+  }
+
+  if (port == MULTICHANNEL_PARALLEL_PORT) {
+    self->parallel = (float *)data;
+    return;
+  }
+
+  connect_port(instance, port, data);
 }
 
-static void run(LV2_Handle instance, uint32_t number_of_samples) {
+static void activate(LV2_Handle instance) {
   NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
 
+  if (!initialize_denoisers(self)) {
+    lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
+    return;
+  }
+
+  *self->report_latency =
+      (float)specbleach_get_latency(self->lib_instances[0]);
+}
+
+static bool send_work(NoiseRepellentPlugin *self,
+                      const WorkMessage *message) {
+  return self->schedule &&
+         self->schedule->schedule_work(self->schedule->handle,
+                                       sizeof(WorkMessage),
+                                       message) == LV2_WORKER_SUCCESS;
+}
+
+// Batches run instances on helper threads, so what they schedule is kept here
+// and sent from the calling thread once every stream is done
+static bool schedule_work(NoiseRepellentPlugin *self, const uint32_t type) {
+  const WorkMessage message = {type, self->profile_generation, 0U, NULL};
+
+  if (!self->deferring_work) {
+    return send_work(self, &message);
+  }
+  if (!self->schedule ||
+      self->number_of_deferred_work >= MAX_DEFERRED_WORK) {
+    return false;
+  }
+  self->deferred_work[self->number_of_deferred_work++] = message;
+  return true;
+}
+
+// Jobs the host turned down once deferred are asked for again next cycle
+static void reject_work(NoiseRepellentPlugin *self, const WorkType type) {
+  switch (type) {
+  case WORK_LINK_NOISE_PROFILES:
+    self->link_pending = false;
+    self->link_requested = true;
+    break;
+  case WORK_PUBLISH_NOISE_PROFILE:
+    self->profile_slot_busy = false;
+    self->publish_pending = true;
+    break;
+  case WORK_FETCH_NOISE_PROFILE:
+    self->profile_slot_busy = false;
+    break;
+  case WORK_LOAD_NOISE_PROFILE:
+  default:
+    break;
+  }
+}
+
+static void send_deferred_work(NoiseRepellentPlugin *self) {
+  for (uint32_t k = 0U; k < self->number_of_deferred_work; k++) {
+    if (!send_work(self, &self->deferred_work[k])) {
+      reject_work(self, (WorkType)self->deferred_work[k].type);
+    }
+  }
+  self->number_of_deferred_work = 0U;
+  self->deferring_work = false;
+}
+
+// Restored profiles may come from any session file, so non finite or negative
+// power values are cleared before they reach the denoiser
+static void sanitize_noise_profile(float *noise_profile,
+                                   const uint32_t profile_size) {
+  for (uint32_t k = 0U; k < profile_size; k++) {
+    if (!isfinite(noise_profile[k]) || noise_profile[k] < 0.F) {
+      noise_profile[k] = 0.F;
+    }
+  }
+}
+
+// Restored and fetched profiles are loaded straight from the read only copy in
+// the store, which instances holding the same profile share. Linked stereo has
+// no second profile and loads the first one in both channels
+static void load_shared_profile(NoiseRepellentPlugin *self,
+                                const SharedProfile *profile) {
+  for (uint32_t channel = 0U; channel < self->number_of_channels; channel++) {
+    specbleach_load_noise_profile(
+        self->lib_instances[channel],
+        profile_store_get_profile(profile, channel), self->profile_size,
+        profile_store_get_averaged_blocks(profile));
+  }
+}
+
+static void load_linked_profile(NoiseRepellentPlugin *self) {
+  for (uint32_t channel = 0U; channel < self->number_of_channels; channel++) {
+    specbleach_load_noise_profile(self->lib_instances[channel],
+                                  self->link_snapshots[0], self->profile_size,
+                                  self->link_averaged_blocks);
+  }
+}
+
+static void reset_noise_profiles(NoiseRepellentPlugin *self) {
+  for (uint32_t channel = 0U; channel < self->number_of_channels; channel++) {
+    specbleach_reset_noise_profile(self->lib_instances[channel]);
+  }
+}
+
+// The denoisers keep learning on the audio thread, so what each channel
+// learned is copied here before anything else reads it
+static bool snapshot_noise_profiles(NoiseRepellentPlugin *self) {
+  if (!specbleach_noise_profile_available(self->lib_instances[0]) ||
+      !specbleach_noise_profile_available(self->lib_instances[1])) {
+    return false;
+  }
+
+  for (uint32_t channel = 0U; channel < 2U; channel++) {
+    memcpy(self->link_snapshots[channel],
+           specbleach_get_noise_profile(self->lib_instances[channel]),
+           sizeof(float) * self->profile_size);
+  }
+  self->link_averaged_blocks =
+      specbleach_get_noise_profile_blocks_averaged(self->lib_instances[0]);
+
+  return true;
+}
+
+// Merges what each channel learned into a single profile computed from the
+// combined power spectrum, so the gain estimation of left and right is driven
+// by the same noise floor. It is left in the first snapshot
+static void merge_noise_profiles(NoiseRepellentPlugin *self) {
+  for (uint32_t k = 0U; k < self->profile_size; k++) {
+    self->link_snapshots[0][k] =
+        0.5F * (self->link_snapshots[0][k] + self->link_snapshots[1][k]);
+  }
+}
+
+// Clearing a profile only zeroes what each denoiser estimated, so it is done
+// right away, once per trigger
+static void update_noise_profile_reset(NoiseRepellentPlugin *self) {
+  if (!(bool)*self->reset_noise_profile) {
+    self->resetting = false;
+    return;
+  }
+
+  if (!self->resetting) {
+    reset_noise_profiles(self);
+    self->resetting = true;
+  }
+}
+
+// Switches apply right away while continuous controls glide to their new
+// value. The denoiser only reloads its parameters when one of them moved,
+// which happens at most once per control period
+static void update_parameters(NoiseRepellentPlugin *self,
+                              const uint32_t number_of_samples) {
+  const float targets[NUMBER_OF_SMOOTHED_CONTROLS] = {
+      [SMOOTHED_REDUCTION_AMOUNT] = *self->reduction_amount,
+      [SMOOTHED_NOISE_RESCALE] = *self->noise_rescale,
+      [SMOOTHED_SMOOTHING_FACTOR] = *self->smoothing_factor,
+      [SMOOTHED_WHITENING_FACTOR] = *self->whitening_factor,
+  };
+  const bool learn_noise = (bool)*self->learn_noise;
+  const bool residual_listen = (bool)*self->residual_listen;
+  const bool transient_protection = (bool)*self->transient_protection;
+
+  const bool gliding =
+      control_smoother_run(self->control_smoother, targets, number_of_samples);
+
+  if (!gliding && learn_noise == self->parameters.learn_noise &&
+      residual_listen == self->parameters.residual_listen &&
+      transient_protection == self->parameters.transient_protection) {
+    return;
+  }
+
+  const float *values = control_smoother_get_values(self->control_smoother);
+
   // clang-format off
   self->parameters = (SpectralBleachParameters){
-      .learn_noise = (bool)*self->learn_noise,
-      .residual_listen = (bool)*self->residual_listen,
-      .transient_protection = (bool)*self->transient_protection,
-      .reduction_amount = *self->reduction_amount,
-      .noise_rescale = *self->noise_rescale,
-      .smoothing_factor = *self->smoothing_factor,
-      .whitening_factor = *self->whitening_factor,
+      .learn_noise = learn_noise,
+      .residual_listen = residual_listen,
+      .transient_protection = transient_protection,
+      .reduction_amount = values[SMOOTHED_REDUCTION_AMOUNT],
+      .noise_rescale = values[SMOOTHED_NOISE_RESCALE],
+      .smoothing_factor = values[SMOOTHED_SMOOTHING_FACTOR],
+      .whitening_factor = values[SMOOTHED_WHITENING_FACTOR],
   };
   // clang-format on
 
-  specbleach_load_parameters(self->lib_instance_1, self->parameters);
+  self->parameters_pending = true;
+}
+
+static void process_instance(NoiseRepellentPlugin *self,
+                             SpectralBleachHandle lib_instance,
+                             SilenceGate *silence_gate, const float *input,
+                             float *output) {
+  if (self->parameters_pending) {
+    specbleach_load_parameters(lib_instance, self->parameters);
+  }
+
+  // Idle input skips the spectral work, but learning still sees it
+  if (silence_gate_run(silence_gate, self->number_of_samples, input) &&
+      !self->parameters.learn_noise) {
+    memset(output, 0, sizeof(float) * self->number_of_samples);
+    return;
+  }
+
+  specbleach_process(lib_instance, self->number_of_samples, input, output);
+}
+
+static void process_channel(void *data, const uint32_t channel) {
+  NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)data;
+
+  process_instance(self, self->lib_instances[channel],
+                   self->silence_gates[channel], self->block_inputs[channel],
+                   self->block_outputs[channel]);
+}
+
+static bool is_output_buffer(const float *input,
+                             const uint32_t number_of_channels,
+                             float *const *outputs) {
+  for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+    if (input == outputs[channel]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Hosts processing in place overwrite the input, so it is kept aside for the
+// crossfade before the denoiser writes the output. The buffer may be shared
+// with the output of any channel, not only with its own
+static void keep_dry_signals(NoiseRepellentPlugin *self,
+                             const uint32_t number_of_channels,
+                             const float *const *inputs, float *const *outputs,
+                             const float **dry_signals) {
+  for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+    dry_signals[channel] = inputs[channel];
+    if (is_output_buffer(inputs[channel], number_of_channels, outputs)) {
+      memcpy(self->dry_signals[channel], inputs[channel],
+             sizeof(float) * self->number_of_samples);
+      dry_signals[channel] = self->dry_signals[channel];
+    }
+  }
+}
+
+// The denoiser is skipped entirely once the fade to dry has converged
+static bool skip_denoiser(NoiseRepellentPlugin *self) {
+  const bool enable = (bool)*self->enable;
+
+  if (!enable && signal_crossfade_is_dry(self->soft_bypass)) {
+    self->denoiser_bypassed = true;
+    self->warmup_samples = 0U;
+  }
+
+  return self->denoiser_bypassed && !enable;
+}
+
+// The dry signal is held back as long as the denoiser output, so fades never
+// comb filter and a bypassed instance still matches the reported latency
+static void delay_dry_signals(NoiseRepellentPlugin *self,
+                              const uint32_t number_of_channels,
+                              const float *const *dry_signals,
+                              float *const *delayed_signals) {
+  for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+    delay_line_run(self->delay_lines[channel], self->number_of_samples,
+                   dry_signals[channel], delayed_signals[channel]);
+  }
+}
+
+static void bypass_denoiser(NoiseRepellentPlugin *self,
+                            const uint32_t number_of_channels,
+                            const float *const *inputs, float *const *outputs) {
+  update_noise_profile_reset(self);
+
+  const float *dry_signals[MAX_CHANNELS] = {NULL};
+  keep_dry_signals(self, number_of_channels, inputs, outputs, dry_signals);
+  delay_dry_signals(self, number_of_channels, dry_signals, outputs);
+}
+
+// After being skipped the denoiser is fed during two latency periods before
+// the fade starts. Frames from before the bypass leave the analysis window
+// after one, but stay in the overlap-add output for another
+static bool soft_bypass_enabled(NoiseRepellentPlugin *self) {
+  if (!self->denoiser_bypassed) {
+    return (bool)*self->enable;
+  }
+
+  self->warmup_samples += self->number_of_samples;
+  if (self->warmup_samples >= 2U * self->latency) {
+    self->denoiser_bypassed = false;
+  }
+
+  return false;
+}
+
+// Monitoring outputs are optional, nothing is measured when none is connected
+static bool monitoring_enabled(const NoiseRepellentPlugin *self) {
+  return self->cycle_time || self->peak_cycle_time || self->learned_blocks ||
+         self->mean_reduction;
+}
+
+static void measure_reduction(NoiseRepellentPlugin *self,
+                              const uint32_t number_of_channels,
+                              const float *const *inputs,
+                              float *const *outputs) {
+  if (self->mean_reduction) {
+    processing_monitor_measure_reduction(
+        self->processing_monitor, self->number_of_samples, number_of_channels,
+        inputs, (const float *const *)outputs);
+  }
+}
+
+static void report_monitoring(NoiseRepellentPlugin *self) {
+  if (self->cycle_time) {
+    *self->cycle_time =
+        processing_monitor_get_cycle_time(self->processing_monitor);
+  }
+  if (self->peak_cycle_time) {
+    *self->peak_cycle_time =
+        processing_monitor_get_peak_cycle_time(self->processing_monitor);
+  }
+  if (self->learned_blocks) {
+    *self->learned_blocks = (float)specbleach_get_noise_profile_blocks_averaged(
+        self->lib_instances[0]);
+  }
+  if (self->mean_reduction) {
+    *self->mean_reduction =
+        processing_monitor_get_reduction(self->processing_monitor);
+  }
+}
+
+// Renders that are not live have no deadline to keep, so channels are spread
+// over the helpers even when parallel processing was left off
+static bool parallel_enabled(const NoiseRepellentPlugin *self) {
+  return (self->parallel && (bool)*self->parallel) ||
+         (self->free_wheeling && (bool)*self->free_wheeling);
+}
+
+static void process_block(NoiseRepellentPlugin *self,
+                          const uint32_t number_of_channels,
+                          const float *const *inputs, float *const *outputs) {
+  if (skip_denoiser(self)) {
+    bypass_denoiser(self, number_of_channels, inputs, outputs);
+    measure_reduction(self, number_of_channels,
+                      (const float *const *)outputs, outputs);
+    return;
+  }
+
+  update_noise_profile_reset(self);
+
+  const float *dry_signals[MAX_CHANNELS] = {NULL};
+  keep_dry_signals(self, number_of_channels, inputs, outputs, dry_signals);
+  delay_dry_signals(self, number_of_channels, dry_signals,
+                    self->delayed_signals);
+
+  // The denoiser reads the kept copy, so it never reads a buffer it writes
+  self->block_inputs = dry_signals;
+  self->block_outputs = outputs;
+
+  // Channels are independent, so idle helpers take whichever is left. Other
+  // instances may be holding them, then channels run here one after another
+  if (!(number_of_channels > 1U && parallel_enabled(self) &&
+        processing_pool_run(self->processing_pool, number_of_channels,
+                            process_channel, self))) {
+    for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+      process_channel(self, channel);
+    }
+  }
+  self->parameters_pending = false;
+
+  signal_crossfade_run(self->soft_bypass, self->number_of_samples,
+                       number_of_channels,
+                       (const float *const *)self->delayed_signals, outputs,
+                       soft_bypass_enabled(self));
+
+  measure_reduction(self, number_of_channels,
+                    (const float *const *)self->delayed_signals, outputs);
+}
+
+// Blocks longer than the announced maximum are split to fit the scratch memory
+static void process_blocks(NoiseRepellentPlugin *self,
+                           const uint32_t number_of_samples) {
+  const uint32_t number_of_channels = self->number_of_channels;
+  const bool monitoring = monitoring_enabled(self);
+
+  if (monitoring) {
+    processing_monitor_start_cycle(self->processing_monitor);
+  }
+
+  for (uint32_t offset = 0U; offset < number_of_samples;
+       offset += self->number_of_samples) {
+    self->number_of_samples = number_of_samples - offset;
+    if (self->number_of_samples > self->block_length.maximum) {
+      self->number_of_samples = self->block_length.maximum;
+    }
+    const uint32_t samples_to_step =
+        control_smoother_get_samples_to_step(self->control_smoother);
+    if (self->number_of_samples > samples_to_step) {
+      self->number_of_samples = samples_to_step;
+    }
+
+    const float *inputs[MAX_CHANNELS] = {NULL};
+    float *outputs[MAX_CHANNELS] = {NULL};
+    for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+      inputs[channel] = &self->inputs[channel][offset];
+      outputs[channel] = &self->outputs[channel][offset];
+    }
+
+    process_block(self, number_of_channels, inputs, outputs);
+    update_parameters(self, self->number_of_samples);
+  }
+
+  if (monitoring) {
+    processing_monitor_end_cycle(self->processing_monitor, number_of_samples);
+    report_monitoring(self);
+  }
+}
+
+static void publish_to_profile_slot(NoiseRepellentPlugin *self) {
+  self->publish_pending = self->profile_slot_index != 0U;
+}
+
+// The denoiser may start learning again while the worker publishes, so what
+// it learned is copied here first
+static bool capture_noise_profiles(NoiseRepellentPlugin *self) {
+  if (!specbleach_noise_profile_available(self->lib_instances[0])) {
+    return false;
+  }
+
+  for (uint32_t k = 0U; k < self->number_of_profiles; k++) {
+    memcpy(self->noise_profiles[k],
+           specbleach_get_noise_profile(self->lib_instances[k]),
+           sizeof(float) * self->profile_size);
+  }
+  self->captured_averaged_blocks =
+      specbleach_get_noise_profile_blocks_averaged(self->lib_instances[0]);
+
+  return true;
+}
+
+// Instances set to the same slot share the profile a finished learn pass left
+// there. The store is locked, so it is only reached from the worker
+static void update_profile_slot(NoiseRepellentPlugin *self,
+                                const bool learn_pass_ended) {
+  uint32_t slot = self->profile_slot ? (uint32_t)*self->profile_slot : 0U;
+  if (slot > PROFILE_STORE_SLOTS || !self->schedule) {
+    slot = 0U;
+  }
+
+  if (slot != self->profile_slot_index) {
+    self->profile_slot_index = slot;
+    self->profile_slot_version = 0U;
+    self->publish_pending = false;
+  }
+
+  if (learn_pass_ended) {
+    publish_to_profile_slot(self);
+  }
+
+  // The capture buffers stay untouched while a publish is in flight
+  if (self->publish_pending) {
+    if (!self->profile_slot_busy) {
+      self->publish_pending = false;
+      if (capture_noise_profiles(self) &&
+          schedule_work(self, WORK_PUBLISH_NOISE_PROFILE)) {
+        self->profile_slot_busy = true;
+      }
+    }
+    return;
+  }
+
+  if (self->profile_slot_index != 0U && !self->profile_slot_busy &&
+      !self->parameters.learn_noise &&
+      profile_store_get_version(self->profile_slot_index) !=
+          self->profile_slot_version &&
+      schedule_work(self, WORK_FETCH_NOISE_PROFILE)) {
+    self->profile_slot_busy = true;
+  }
+}
+
+static void publish_noise_profiles(NoiseRepellentPlugin *self,
+                                   WorkMessage *message) {
+  const uint32_t version = profile_store_publish(
+      self->profile_slot_index, self->profile_size, self->number_of_profiles,
+      (const float *const *)self->noise_profiles,
+      self->captured_averaged_blocks);
+
+  message->version = version != 0U ? version : self->profile_slot_version;
+}
+
+static void fetch_noise_profiles(NoiseRepellentPlugin *self,
+                                 WorkMessage *message) {
+  message->profile = profile_store_fetch(
+      self->profile_slot_index, self->profile_size, &message->version);
+}
+
+// Without denoisers, as when building them failed, the input is passed through
+static bool pass_through_uninitialized(NoiseRepellentPlugin *self,
+                                       const uint32_t number_of_samples) {
+  if (self->denoisers_ready) {
+    return false;
+  }
+
+  for (uint32_t channel = 0U; channel < self->number_of_channels; channel++) {
+    if (self->inputs[channel] != self->outputs[channel]) {
+      memcpy(self->outputs[channel], self->inputs[channel],
+             sizeof(float) * number_of_samples);
+    }
+  }
+
+  return true;
+}
+
+static void run(LV2_Handle instance, uint32_t number_of_samples) {
+  NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
 
-  if ((bool)*self->reset_noise_profile) {
-    specbleach_reset_noise_profile(self->lib_instance_1);
+  if (pass_through_uninitialized(self, number_of_samples)) {
+    return;
   }
 
-  specbleach_process(self->lib_instance_1, number_of_samples, self->input_1,
-                     self->output_1);
+  update_parameters(self, 0U);
+
+  update_profile_slot(self, self->learning && !self->parameters.learn_noise);
+  self->learning = self->parameters.learn_noise;
 
-  signal_crossfade_run(self->soft_bypass, number_of_samples, self->input_1,
-                       self->output_1, (bool)*self->enable);
+  process_blocks(self, number_of_samples);
 }
 
-static void run_stereo(LV2_Handle instance, uint32_t number_of_samples) {
+static void run_stereo_linked(LV2_Handle instance, uint32_t number_of_samples) {
   NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
 
-  run(instance, number_of_samples);
+  if (pass_through_uninitialized(self, number_of_samples)) {
+    return;
+  }
+
+  update_parameters(self, 0U);
 
-  specbleach_load_parameters(self->lib_instance_2, self->parameters);
+  // Hosts may run the worker synchronously, so a response must already see
+  // the learn pass as finished
+  const bool learn_pass_ended =
+      self->learning && !self->parameters.learn_noise;
+  self->learning = self->parameters.learn_noise;
 
-  if ((bool)*self->reset_noise_profile) {
-    specbleach_reset_noise_profile(self->lib_instance_2);
+  // When a learn pass ends both channels switch to the merged profile. The
+  // snapshots stay untouched until the worker has merged them
+  if (learn_pass_ended) {
+    self->link_requested = true;
+  }
+  if (self->link_requested && !self->link_pending) {
+    self->link_requested = false;
+    if (snapshot_noise_profiles(self)) {
+      self->link_pending = true;
+      if (!schedule_work(self, WORK_LINK_NOISE_PROFILES)) {
+        self->link_pending = false;
+        merge_noise_profiles(self);
+        load_linked_profile(self);
+      }
+    }
   }
 
-  specbleach_process(self->lib_instance_2, number_of_samples, self->input_2,
-                     self->output_2);
+  // The merged profile is published once the worker has linked both channels
+  update_profile_slot(self, false);
 
-  signal_crossfade_run(self->soft_bypass, number_of_samples, self->input_2,
-                       self->output_2, (bool)*self->enable);
+  process_blocks(self, number_of_samples);
 }
 
 static LV2_State_Status save(LV2_Handle instance,
@@ -363,39 +1259,57 @@ static LV2_State_Status save(LV2_Handle instance,
                              LV2_State_Handle handle, uint32_t flags,
                              const LV2_Feature *const *features) {
   NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
-  if (!specbleach_noise_profile_available(self->lib_instance_1)) {
+  if (!self->denoisers_ready ||
+      !specbleach_noise_profile_available(self->lib_instances[0])) {
     return LV2_STATE_SUCCESS;
   }
 
+  // Hosts copy what is stored, so the serialized profile is only built here
+  NoiseProfileState *noise_profile_state =
+      noise_profile_state_initialize(self->uris.atom_Float, self->profile_size);
+  if (!noise_profile_state) {
+    return LV2_STATE_ERR_NO_SPACE;
+  }
+
   store(handle, self->state.property_noise_profile_size, &self->profile_size,
         sizeof(uint32_t), self->uris.atom_Int,
         LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
 
   uint32_t noise_profile_averaged_blocks =
-      specbleach_get_noise_profile_blocks_averaged(self->lib_instance_1);
+      specbleach_get_noise_profile_blocks_averaged(self->lib_instances[0]);
 
   store(handle, self->state.property_averaged_blocks,
         &noise_profile_averaged_blocks, sizeof(uint32_t), self->uris.atom_Int,
         LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
 
-  memcpy(noise_profile_get_elements(self->noise_profile_state_1),
-         specbleach_get_noise_profile(self->lib_instance_1),
-         sizeof(float) * self->profile_size);
-
-  store(handle, self->state.property_noise_profile_1,
-        (void *)self->noise_profile_state_1, noise_profile_get_size(),
-        self->uris.atom_Vector, LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+  store(handle, self->state.property_sample_rate, &self->sample_rate,
+        sizeof(float), self->uris.atom_Float,
+        LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
 
-  if (strstr(self->plugin_uri, NOISEREPELLENT_STEREO_URI)) {
-    memcpy(noise_profile_get_elements(self->noise_profile_state_2),
-           specbleach_get_noise_profile(self->lib_instance_2),
-           sizeof(float) * self->profile_size);
+  for (uint32_t k = 0U; k < self->number_of_profiles; k++) {
+    float *elements = noise_profile_get_elements(noise_profile_state);
+    if (is_stereo_linked(self) &&
+        specbleach_noise_profile_available(self->lib_instances[1])) {
+      // Once merged both channels hold the same profile. Before that their
+      // mean is what the merge will give them
+      const float *left = specbleach_get_noise_profile(self->lib_instances[0]);
+      const float *right = specbleach_get_noise_profile(self->lib_instances[1]);
+      for (uint32_t n = 0U; n < self->profile_size; n++) {
+        elements[n] = 0.5F * (left[n] + right[n]);
+      }
+    } else {
+      memcpy(elements, specbleach_get_noise_profile(self->lib_instances[k]),
+             sizeof(float) * self->profile_size);
+    }
 
-    store(handle, self->state.property_noise_profile_2,
-          (void *)self->noise_profile_state_2, noise_profile_get_size(),
-          self->uris.atom_Vector, LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+    store(handle, self->state.property_noise_profiles[k],
+          noise_profile_get_body(noise_profile_state),
+          noise_profile_get_size(noise_profile_state), self->uris.atom_Vector,
+          LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
   }
 
+  noise_profile_state_free(noise_profile_state);
+
   return LV2_STATE_SUCCESS;
 }
 
@@ -421,42 +1335,183 @@ static LV2_State_Status restore(LV2_Handle instance,
     return LV2_STATE_ERR_NO_PROPERTY;
   }
 
-  const void *saved_noise_profile_1 = retrieve(
-      handle, self->state.property_noise_profile_1, &size, &type, &valflags);
-  if (!saved_noise_profile_1 || size != noise_profile_get_size() ||
-      type != self->uris.atom_Vector) {
-    return LV2_STATE_ERR_NO_PROPERTY;
+  // Hosts may restore before activating, the profile size comes from the
+  // denoisers
+  if (!initialize_denoisers(self)) {
+    return LV2_STATE_ERR_UNKNOWN;
   }
 
-  memcpy(self->noise_profile_1, (float *)LV2_ATOM_BODY(saved_noise_profile_1),
-         sizeof(float) * self->profile_size);
+  // Profiles saved without their sample rate can only be used as they are
+  const float *samplerate = (const float *)retrieve(
+      handle, self->state.property_sample_rate, &size, &type, &valflags);
+  if (samplerate != NULL &&
+      (type != self->uris.atom_Float || !(*samplerate > 0.F))) {
+    samplerate = NULL;
+  }
 
-  specbleach_load_noise_profile(self->lib_instance_1, self->noise_profile_1,
-                                *fftsize, *averagedblocks);
+  const bool resample =
+      samplerate != NULL && (*fftsize != self->profile_size ||
+                             *samplerate != self->sample_rate);
+  if (*fftsize != self->profile_size && !resample) {
+    return LV2_STATE_ERR_NO_PROPERTY;
+  }
 
-  if (strstr(self->plugin_uri, NOISEREPELLENT_STEREO_URI)) {
-    const void *saved_noise_profile_2 = retrieve(
-        handle, self->state.property_noise_profile_2, &size, &type, &valflags);
-    if (!saved_noise_profile_2 || size != noise_profile_get_size() ||
-        type != self->uris.atom_Vector) {
+  // Sessions saved before every channel had a key of its own only hold the
+  // first profile, which the channels missing theirs reuse
+  const float *saved_elements[MAX_CHANNELS] = {NULL};
+  for (uint32_t k = 0U; k < self->number_of_profiles; k++) {
+    const void *saved_noise_profile =
+        retrieve(handle, self->state.property_noise_profiles[k], &size, &type,
+                 &valflags);
+    if (!saved_noise_profile && k > 0U) {
+      saved_elements[k] = saved_elements[0];
+      continue;
+    }
+    saved_elements[k] =
+        noise_profile_state_read(saved_noise_profile, size, *fftsize);
+    if (!saved_elements[k] || type != self->uris.atom_Vector) {
       return LV2_STATE_ERR_NO_PROPERTY;
     }
+  }
 
-    memcpy(self->noise_profile_2, (float *)LV2_ATOM_BODY(saved_noise_profile_2),
-           sizeof(float) * self->profile_size);
+  // The capture buffers may be in use by the worker, restored profiles are
+  // prepared apart before going to the store
+  float *restored =
+      (float *)malloc(sizeof(float) * self->number_of_profiles *
+                      self->profile_size);
+  if (!restored) {
+    return LV2_STATE_ERR_UNKNOWN;
+  }
+
+  const float *restored_profiles[MAX_CHANNELS] = {NULL};
+  for (uint32_t k = 0U; k < self->number_of_profiles; k++) {
+    float *restored_profile = &restored[k * self->profile_size];
+    if (resample) {
+      profile_resampler_run(saved_elements[k], *fftsize, *samplerate,
+                            restored_profile, self->profile_size,
+                            self->sample_rate);
+    } else {
+      memcpy(restored_profile, saved_elements[k],
+             sizeof(float) * self->profile_size);
+    }
+    sanitize_noise_profile(restored_profile, self->profile_size);
+    restored_profiles[k] = restored_profile;
+  }
 
-    specbleach_load_noise_profile(self->lib_instance_2, self->noise_profile_2,
-                                  *fftsize, *averagedblocks);
+  const SharedProfile *profile =
+      profile_store_share(self->profile_size, self->number_of_profiles,
+                          restored_profiles, *averagedblocks);
+  free(restored);
+  if (!profile) {
+    return LV2_STATE_ERR_UNKNOWN;
+  }
+
+  // Profiles are swapped in between cycles through the worker when the host
+  // provides one for restoring, the message holding the reference until then
+  LV2_Worker_Schedule *schedule =
+      (LV2_Worker_Schedule *)lv2_features_data(features, LV2_WORKER__schedule);
+  self->profile_generation++;
+  const WorkMessage message = {WORK_LOAD_NOISE_PROFILE,
+                               self->profile_generation, 0U, profile};
+
+  if (!schedule ||
+      schedule->schedule_work(schedule->handle, sizeof(WorkMessage),
+                              &message) != LV2_WORKER_SUCCESS) {
+    load_shared_profile(self, profile);
+    profile_store_unshare(profile);
   }
 
   return LV2_STATE_SUCCESS;
 }
 
+static LV2_Worker_Status work(LV2_Handle instance,
+                              LV2_Worker_Respond_Function respond,
+                              LV2_Worker_Respond_Handle handle, uint32_t size,
+                              const void *data) {
+  NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
+
+  if (size != sizeof(WorkMessage)) {
+    return LV2_WORKER_ERR_UNKNOWN;
+  }
+
+  WorkMessage message;
+  memcpy(&message, data, sizeof(WorkMessage));
+
+  switch ((WorkType)message.type) {
+  case WORK_LINK_NOISE_PROFILES:
+    merge_noise_profiles(self);
+    break;
+  case WORK_PUBLISH_NOISE_PROFILE:
+    publish_noise_profiles(self, &message);
+    break;
+  case WORK_FETCH_NOISE_PROFILE:
+    fetch_noise_profiles(self, &message);
+    break;
+  case WORK_LOAD_NOISE_PROFILE:
+  default:
+    break;
+  }
+
+  return respond(handle, sizeof(WorkMessage), &message);
+}
+
+static LV2_Worker_Status work_response(LV2_Handle instance, uint32_t size,
+                                       const void *data) {
+  NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
+
+  if (size != sizeof(WorkMessage)) {
+    return LV2_WORKER_ERR_UNKNOWN;
+  }
+
+  WorkMessage message;
+  memcpy(&message, data, sizeof(WorkMessage));
+
+  // A restore since the job was scheduled has the last word on the profile
+  const bool current = message.generation == self->profile_generation;
+
+  switch ((WorkType)message.type) {
+  case WORK_LOAD_NOISE_PROFILE:
+    if (current && message.profile) {
+      load_shared_profile(self, message.profile);
+    }
+    break;
+  case WORK_LINK_NOISE_PROFILES:
+    self->link_pending = false;
+    // A new learn pass started meanwhile, so the merged profile is stale
+    if (current && !self->learning) {
+      load_linked_profile(self);
+      publish_to_profile_slot(self);
+    }
+    break;
+  case WORK_PUBLISH_NOISE_PROFILE:
+    self->profile_slot_version = message.version;
+    self->profile_slot_busy = false;
+    break;
+  case WORK_FETCH_NOISE_PROFILE:
+    if (current && message.profile && !self->learning) {
+      load_shared_profile(self, message.profile);
+    }
+    self->profile_slot_version = message.version;
+    self->profile_slot_busy = false;
+    break;
+  default:
+    break;
+  }
+
+  profile_store_unshare(message.profile);
+
+  return LV2_WORKER_SUCCESS;
+}
+
 static const void *extension_data(const char *uri) {
   static const LV2_State_Interface state = {save, restore};
+  static const LV2_Worker_Interface worker = {work, work_response, NULL};
   if (strcmp(uri, LV2_STATE__interface) == 0) {
     return &state;
   }
+  if (strcmp(uri, LV2_WORKER__interface) == 0) {
+    return &worker;
+  }
   return NULL;
 }
 
@@ -464,7 +1519,7 @@ static const void *extension_data(const char *uri) {
 static const LV2_Descriptor descriptor = {
     NOISEREPELLENT_URI,
     instantiate,
-    connect_port,
+    connect_port_mono,
     activate,
     run,
     NULL,
@@ -477,11 +1532,75 @@ static const LV2_Descriptor descriptor_stereo = {
     instantiate,
     connect_port_stereo,
     activate,
-    run_stereo,
+    run,
+    NULL,
+    cleanup,
+    extension_data
+};
+
+static const LV2_Descriptor descriptor_stereo_linked = {
+    NOISEREPELLENT_STEREO_LINKED_URI,
+    instantiate,
+    connect_port_stereo,
+    activate,
+    run_stereo_linked,
     NULL,
     cleanup,
     extension_data
 };
+
+static const LV2_Descriptor descriptors_multichannel[] = {
+    {
+        NOISEREPELLENT_MULTICHANNEL_URI "#4ch",
+        instantiate,
+        connect_port_multichannel,
+        activate,
+        run,
+        NULL,
+        cleanup,
+        extension_data
+    },
+    {
+        NOISEREPELLENT_MULTICHANNEL_URI "#6ch",
+        instantiate,
+        connect_port_multichannel,
+        activate,
+        run,
+        NULL,
+        cleanup,
+        extension_data
+    },
+    {
+        NOISEREPELLENT_MULTICHANNEL_URI "#8ch",
+        instantiate,
+        connect_port_multichannel,
+        activate,
+        run,
+        NULL,
+        cleanup,
+        extension_data
+    },
+    {
+        NOISEREPELLENT_MULTICHANNEL_URI "#12ch",
+        instantiate,
+        connect_port_multichannel,
+        activate,
+        run,
+        NULL,
+        cleanup,
+        extension_data
+    },
+    {
+        NOISEREPELLENT_MULTICHANNEL_URI "#16ch",
+        instantiate,
+        connect_port_multichannel,
+        activate,
+        run,
+        NULL,
+        cleanup,
+        extension_data
+    },
+};
 // clang-format on
 
 LV2_SYMBOL_EXPORT const LV2_Descriptor *lv2_descriptor(uint32_t index) {
@@ -490,7 +1609,93 @@ LV2_SYMBOL_EXPORT const LV2_Descriptor *lv2_descriptor(uint32_t index) {
     return &descriptor;
   case 1:
     return &descriptor_stereo;
+  case 2:
+    return &descriptor_stereo_linked;
   default:
+    if (index - 3U < NUMBER_OF_MULTICHANNEL_VARIANTS) {
+      return &descriptors_multichannel[index - 3U];
+    }
+    return NULL;
+  }
+}
+
+struct NoiseRepellentBatch {
+  ProcessingPool *processing_pool;
+  const NoiseRepellentStream *streams;
+  uint32_t number_of_samples;
+};
+
+LV2_SYMBOL_EXPORT NoiseRepellentBatch *
+nrepellent_batch_initialize(const uint32_t number_of_workers) {
+  NoiseRepellentBatch *self =
+      (NoiseRepellentBatch *)calloc(1U, sizeof(NoiseRepellentBatch));
+  if (!self) {
     return NULL;
   }
+
+  // Without helpers every stream runs on the calling thread
+  if (number_of_workers > 0U) {
+    self->processing_pool = processing_pool_initialize(number_of_workers);
+  }
+
+  return self;
+}
+
+LV2_SYMBOL_EXPORT void nrepellent_batch_free(NoiseRepellentBatch *self) {
+  if (!self) {
+    return;
+  }
+
+  if (self->processing_pool) {
+    processing_pool_free(self->processing_pool);
+  }
+
+  free(self);
+}
+
+static void process_stream(void *data, const uint32_t stream_index) {
+  NoiseRepellentBatch *self = (NoiseRepellentBatch *)data;
+  const NoiseRepellentStream *stream = &self->streams[stream_index];
+  NoiseRepellentPlugin *plugin = (NoiseRepellentPlugin *)stream->instance;
+
+  plugin->inputs[0] = stream->input;
+  plugin->outputs[0] = stream->output;
+  run(stream->instance, self->number_of_samples);
+}
+
+// Streams are independent instances, so helpers take whichever is left. Each
+// instance keeps its buffers in one arena, which is walked in a single pass
+LV2_SYMBOL_EXPORT bool nrepellent_batch_run(NoiseRepellentBatch *self,
+                                            const uint32_t number_of_streams,
+                                            const NoiseRepellentStream *streams,
+                                            const uint32_t number_of_samples) {
+  // Marking instances as deferring their work also finds the repeated ones
+  for (uint32_t k = 0U; k < number_of_streams; k++) {
+    NoiseRepellentPlugin *plugin = (NoiseRepellentPlugin *)streams[k].instance;
+    if (!plugin || plugin->number_of_channels != 1U ||
+        plugin->deferring_work) {
+      for (uint32_t marked = 0U; marked < k; marked++) {
+        ((NoiseRepellentPlugin *)streams[marked].instance)->deferring_work =
+            false;
+      }
+      return false;
+    }
+    plugin->deferring_work = true;
+  }
+
+  self->streams = streams;
+  self->number_of_samples = number_of_samples;
+
+  if (!processing_pool_run(self->processing_pool, number_of_streams,
+                           process_stream, self)) {
+    for (uint32_t k = 0U; k < number_of_streams; k++) {
+      process_stream(self, k);
+    }
+  }
+
+  for (uint32_t k = 0U; k < number_of_streams; k++) {
+    send_deferred_work((NoiseRepellentPlugin *)streams[k].instance);
+  }
+
+  return true;
 }
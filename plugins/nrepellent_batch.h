@@ -0,0 +1,61 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef NREPELLENT_BATCH_H
+#define NREPELLENT_BATCH_H
+
+#include "lv2/core/lv2.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Entry point for hosts embedding many mono instances of the plugin library.
+// Instances come from its first LV2 descriptor and keep their control ports
+// and worker as usual, only the audio buffers are given with each batch.
+//
+// A batch takes the place of run() for its instances and has the same
+// threading class. It must not overlap with run() or another batch on any of
+// them. Each instance can appear once per batch, a repeated one makes the
+// whole batch fail before anything runs. Streams run on the helpers, but work
+// the instances schedule reaches the host from the calling thread, after
+// every stream is done.
+//
+// Streams are given one buffer each instead of a planar block of all of them.
+// Every instance analyses its own STFT frames, so there is no work across
+// streams that such a layout would let run in the same vector lanes
+
+typedef struct NoiseRepellentStream {
+  LV2_Handle instance;
+  const float *input;
+  float *output;
+} NoiseRepellentStream;
+
+typedef struct NoiseRepellentBatch NoiseRepellentBatch;
+
+// Without workers every stream runs on the calling thread. Freeing NULL does
+// nothing
+LV2_SYMBOL_EXPORT NoiseRepellentBatch *
+nrepellent_batch_initialize(uint32_t number_of_workers);
+LV2_SYMBOL_EXPORT void nrepellent_batch_free(NoiseRepellentBatch *self);
+LV2_SYMBOL_EXPORT bool nrepellent_batch_run(NoiseRepellentBatch *self,
+                                            uint32_t number_of_streams,
+                                            const NoiseRepellentStream *streams,
+                                            uint32_t number_of_samples);
+
+#endif
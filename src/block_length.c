@@ -0,0 +1,68 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "block_length.h"
+#include "lv2/atom/atom.h"
+#include "lv2/buf-size/buf-size.h"
+
+// Used when the host gives no bounds, longer blocks are split in this size
+#define DEFAULT_MAX_BLOCK_LENGTH 8192U
+
+static uint32_t read_length(const LV2_Options_Option *option,
+                            const LV2_URID atom_int) {
+  if (option->type != atom_int || option->size != sizeof(int32_t) ||
+      *(const int32_t *)option->value <= 0) {
+    return 0U;
+  }
+  return (uint32_t)*(const int32_t *)option->value;
+}
+
+BlockLength block_length_read_options(LV2_URID_Map *map,
+                                      const LV2_Options_Option *options) {
+  BlockLength block_length = {0U, 0U};
+
+  if (options) {
+    const LV2_URID atom_int = map->map(map->handle, LV2_ATOM__Int);
+    const LV2_URID max_block_length =
+        map->map(map->handle, LV2_BUF_SIZE__maxBlockLength);
+    const LV2_URID nominal_block_length =
+        map->map(map->handle, LV2_BUF_SIZE__nominalBlockLength);
+
+    for (const LV2_Options_Option *option = options; option->key; option++) {
+      if (option->key == max_block_length) {
+        block_length.maximum = read_length(option, atom_int);
+      } else if (option->key == nominal_block_length) {
+        block_length.nominal = read_length(option, atom_int);
+      }
+    }
+  }
+
+  if (block_length.maximum == 0U) {
+    block_length.maximum = block_length.nominal > DEFAULT_MAX_BLOCK_LENGTH
+                               ? block_length.nominal
+                               : DEFAULT_MAX_BLOCK_LENGTH;
+  }
+  if (block_length.nominal == 0U ||
+      block_length.nominal > block_length.maximum) {
+    block_length.nominal = block_length.maximum;
+  }
+
+  return block_length;
+}
@@ -0,0 +1,36 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef BLOCK_LENGTH_H
+#define BLOCK_LENGTH_H
+
+#include "lv2/options/options.h"
+#include "lv2/urid/urid.h"
+#include <stdint.h>
+
+typedef struct BlockLength {
+  uint32_t maximum;
+  uint32_t nominal;
+} BlockLength;
+
+BlockLength block_length_read_options(LV2_URID_Map *map,
+                                      const LV2_Options_Option *options);
+
+#endif
@@ -0,0 +1,144 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "control_smoother.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct ControlSmoother {
+  uint32_t number_of_controls;
+  uint32_t smoothing_samples;
+  uint32_t remaining_samples;
+  uint32_t period;
+  uint32_t elapsed_samples;
+  bool initialized;
+
+  float *targets;
+  float *values;
+  float *steps;
+};
+
+ControlSmoother *control_smoother_initialize(const uint32_t number_of_controls,
+                                             const uint32_t sample_rate) {
+  ControlSmoother *self =
+      (ControlSmoother *)calloc(1U, sizeof(ControlSmoother));
+  if (!self) {
+    return NULL;
+  }
+
+  self->number_of_controls = number_of_controls;
+  self->smoothing_samples =
+      (uint32_t)(((uint64_t)CONTROL_SMOOTHING_MS * sample_rate) / 1000U);
+  self->period =
+      (uint32_t)(((uint64_t)CONTROL_PERIOD_MS * sample_rate) / 1000U);
+  if (self->period == 0U) {
+    self->period = 1U;
+  }
+
+  self->targets = (float *)calloc(number_of_controls, sizeof(float));
+  self->values = (float *)calloc(number_of_controls, sizeof(float));
+  self->steps = (float *)calloc(number_of_controls, sizeof(float));
+  if (!self->targets || !self->values || !self->steps) {
+    control_smoother_free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void control_smoother_free(ControlSmoother *self) {
+  free(self->targets);
+  free(self->values);
+  free(self->steps);
+  free(self);
+}
+
+const float *control_smoother_get_values(const ControlSmoother *self) {
+  return self->values;
+}
+
+static void start_ramp(ControlSmoother *self, const float *targets) {
+  memcpy(self->targets, targets, sizeof(float) * self->number_of_controls);
+
+  self->remaining_samples = self->smoothing_samples;
+  for (uint32_t i = 0U; i < self->number_of_controls; i++) {
+    self->steps[i] = self->smoothing_samples > 0U
+                         ? (targets[i] - self->values[i]) /
+                               (float)self->smoothing_samples
+                         : 0.F;
+  }
+}
+
+// Advances the ramp by the samples processed since the last call. Returns
+// whether the values moved, so callers only reload what they derive from them
+// when something actually changed
+bool control_smoother_run(ControlSmoother *self, const float *targets,
+                          const uint32_t number_of_samples) {
+  const size_t size = sizeof(float) * self->number_of_controls;
+
+  if (!self->initialized) {
+    memcpy(self->targets, targets, size);
+    memcpy(self->values, targets, size);
+    self->initialized = true;
+    return true;
+  }
+
+  if (memcmp(self->targets, targets, size) != 0) {
+    start_ramp(self, targets);
+  } else if (self->remaining_samples == 0U &&
+             memcmp(self->values, self->targets, size) == 0) {
+    self->elapsed_samples = 0U;
+    return false;
+  }
+
+  // Automation keeps restarting the ramp, the period still runs through it
+  self->elapsed_samples += number_of_samples;
+  if (self->elapsed_samples < self->period &&
+      self->elapsed_samples < self->remaining_samples) {
+    return false;
+  }
+
+  if (self->elapsed_samples >= self->remaining_samples) {
+    memcpy(self->values, self->targets, size);
+    self->remaining_samples = 0U;
+  } else {
+    self->remaining_samples -= self->elapsed_samples;
+    for (uint32_t i = 0U; i < self->number_of_controls; i++) {
+      self->values[i] += self->steps[i] * (float)self->elapsed_samples;
+    }
+  }
+  self->elapsed_samples = 0U;
+
+  return true;
+}
+
+// Blocks are split at the next step so long buffers still glide
+uint32_t control_smoother_get_samples_to_step(const ControlSmoother *self) {
+  if (self->remaining_samples == 0U) {
+    return UINT32_MAX;
+  }
+
+  const uint32_t next_step = self->remaining_samples < self->period
+                                 ? self->remaining_samples
+                                 : self->period;
+  return next_step > self->elapsed_samples
+             ? next_step - self->elapsed_samples
+             : 1U;
+}
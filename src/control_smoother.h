@@ -0,0 +1,47 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef CONTROL_SMOOTHER_H
+#define CONTROL_SMOOTHER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef CONTROL_SMOOTHING_MS
+#define CONTROL_SMOOTHING_MS 20U
+#endif
+
+// Values step at most once per period, close to the hop of the denoiser which
+// only picks up new parameters once per frame anyway
+#ifndef CONTROL_PERIOD_MS
+#define CONTROL_PERIOD_MS 5U
+#endif
+
+typedef struct ControlSmoother ControlSmoother;
+
+ControlSmoother *control_smoother_initialize(uint32_t number_of_controls,
+                                             uint32_t sample_rate);
+void control_smoother_free(ControlSmoother *self);
+const float *control_smoother_get_values(const ControlSmoother *self);
+bool control_smoother_run(ControlSmoother *self, const float *targets,
+                          uint32_t number_of_samples);
+uint32_t control_smoother_get_samples_to_step(const ControlSmoother *self);
+
+#endif
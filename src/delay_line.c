@@ -0,0 +1,139 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "delay_line.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Past input kept in a ring as long as the longest delay, read back a fixed
+// distance behind where it is written
+struct DelayLine {
+  uint32_t length;
+  uint32_t delay;
+  uint32_t write_position;
+  uint32_t previous_delay;
+  uint32_t fade_length;
+  uint32_t fade_remaining;
+  float *samples;
+};
+
+DelayLine *delay_line_initialize(const uint32_t maximum_delay) {
+  if (maximum_delay == 0U) {
+    return NULL;
+  }
+
+  DelayLine *self = (DelayLine *)calloc(1U, sizeof(DelayLine));
+  if (!self) {
+    return NULL;
+  }
+
+  self->length = maximum_delay;
+  self->delay = maximum_delay;
+  self->samples = (float *)calloc(maximum_delay, sizeof(float));
+  if (!self->samples) {
+    delay_line_free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void delay_line_free(DelayLine *self) {
+  free(self->samples);
+  free(self);
+}
+
+// The ring keeps being written whatever the delay, so a new one reads valid
+// past input right away
+void delay_line_set_delay(DelayLine *self, const uint32_t delay) {
+  self->delay = delay < self->length ? delay : self->length;
+  self->fade_remaining = 0U;
+}
+
+// Jumping to another delay repeats or skips part of the input, so the output
+// fades from the old distance to the new one instead
+void delay_line_fade_to_delay(DelayLine *self, const uint32_t delay,
+                              const uint32_t fade_length) {
+  const uint32_t previous_delay = self->delay;
+  delay_line_set_delay(self, delay);
+  if (fade_length > 0U && self->delay != previous_delay) {
+    self->previous_delay = previous_delay;
+    self->fade_length = fade_length;
+    self->fade_remaining = fade_length;
+  }
+}
+
+static uint32_t min_length(const uint32_t a, const uint32_t b) {
+  return a < b ? a : b;
+}
+
+// Blends what the previous delay reads into the chunk, before the chunk input
+// is written over it
+static void fade_chunk(DelayLine *self, const uint32_t chunk_size,
+                       const float *input, float *output) {
+  for (uint32_t k = 0U; k < chunk_size && self->fade_remaining > 0U; k++) {
+    const float previous =
+        self->previous_delay > 0U
+            ? self->samples[(self->write_position + k + self->length -
+                             self->previous_delay) %
+                            self->length]
+            : input[k];
+    const float gain = 1.F - (float)self->fade_remaining /
+                                 (float)(self->fade_length + 1U);
+    output[k] = previous + gain * (output[k] - previous);
+    self->fade_remaining--;
+  }
+}
+
+// Input and output must not overlap
+void delay_line_run(DelayLine *self, const uint32_t number_of_samples,
+                    const float *input, float *output) {
+  uint32_t read_position =
+      (self->write_position + self->length - self->delay) % self->length;
+
+  // Chunks are cut where either position wraps and never span more than the
+  // delay, so each one reads only what earlier chunks have written
+  uint32_t offset = 0U;
+  while (offset < number_of_samples) {
+    uint32_t chunk_size = number_of_samples - offset;
+    chunk_size = min_length(chunk_size, self->length - read_position);
+    chunk_size = min_length(chunk_size, self->length - self->write_position);
+    if (self->fade_remaining > 0U && self->previous_delay > 0U) {
+      chunk_size = min_length(chunk_size, self->previous_delay);
+    }
+    if (self->delay > 0U) {
+      chunk_size = min_length(chunk_size, self->delay);
+      memcpy(&output[offset], &self->samples[read_position],
+             sizeof(float) * chunk_size);
+    } else {
+      memcpy(&output[offset], &input[offset], sizeof(float) * chunk_size);
+    }
+    if (self->fade_remaining > 0U) {
+      fade_chunk(self, chunk_size, &input[offset], &output[offset]);
+    }
+
+    memcpy(&self->samples[self->write_position], &input[offset],
+           sizeof(float) * chunk_size);
+
+    read_position = (read_position + chunk_size) % self->length;
+    self->write_position = (self->write_position + chunk_size) % self->length;
+    offset += chunk_size;
+  }
+}
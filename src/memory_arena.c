@@ -0,0 +1,141 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "memory_arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define CACHE_LINE_SIZE 64U
+
+struct MemoryArena {
+  char *memory;
+  size_t capacity;
+  size_t used;
+  bool locked;
+};
+
+#if defined(_WIN32)
+static long get_page_size(void) {
+  SYSTEM_INFO system_info;
+  GetSystemInfo(&system_info);
+  return (long)system_info.dwPageSize;
+}
+
+static void *allocate_aligned(const size_t alignment, const size_t size) {
+  return _aligned_malloc(size, alignment);
+}
+
+static void free_aligned(void *memory) { _aligned_free(memory); }
+
+static bool lock_pages(void *memory, const size_t size) {
+  return VirtualLock(memory, size) != 0;
+}
+
+static void unlock_pages(void *memory, const size_t size) {
+  VirtualUnlock(memory, size);
+}
+#else
+static long get_page_size(void) { return sysconf(_SC_PAGESIZE); }
+
+static void *allocate_aligned(const size_t alignment, const size_t size) {
+  void *memory = NULL;
+  return posix_memalign(&memory, alignment, size) == 0 ? memory : NULL;
+}
+
+static void free_aligned(void *memory) { free(memory); }
+
+static bool lock_pages(void *memory, const size_t size) {
+  return mlock(memory, size) == 0;
+}
+
+static void unlock_pages(void *memory, const size_t size) {
+  munlock(memory, size);
+}
+#endif
+
+size_t memory_arena_get_slice_size(const size_t size) {
+  return (size + CACHE_LINE_SIZE - 1U) & ~(size_t)(CACHE_LINE_SIZE - 1U);
+}
+
+MemoryArena *memory_arena_initialize(const size_t capacity) {
+  MemoryArena *self = (MemoryArena *)calloc(1U, sizeof(MemoryArena));
+  if (!self) {
+    return NULL;
+  }
+
+  // Whole pages are reserved so that locking them never pins memory owned by
+  // other allocations
+  const long page_size = get_page_size();
+  const size_t alignment =
+      page_size > (long)CACHE_LINE_SIZE ? (size_t)page_size : CACHE_LINE_SIZE;
+  self->capacity = (capacity + alignment - 1U) / alignment * alignment;
+
+  void *memory =
+      self->capacity > 0U ? allocate_aligned(alignment, self->capacity) : NULL;
+  if (!memory) {
+    free(self);
+    return NULL;
+  }
+
+  // Clearing touches every page, so none of them faults on the first cycle
+  self->memory = (char *)memory;
+  memset(self->memory, 0, self->capacity);
+
+  return self;
+}
+
+void memory_arena_free(MemoryArena *self) {
+  if (self->locked) {
+    unlock_pages(self->memory, self->capacity);
+  }
+
+  free_aligned(self->memory);
+  free(self);
+}
+
+void *memory_arena_allocate(MemoryArena *self, const size_t size) {
+  const size_t slice_size = memory_arena_get_slice_size(size);
+  if (slice_size == 0U || slice_size > self->capacity - self->used) {
+    return NULL;
+  }
+
+  void *slice = &self->memory[self->used];
+  self->used += slice_size;
+
+  return slice;
+}
+
+bool memory_arena_lock(MemoryArena *self) {
+  if (!self->locked) {
+    self->locked = lock_pages(self->memory, self->capacity);
+  }
+
+  return self->locked;
+}
@@ -0,0 +1,37 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef MEMORY_ARENA_H
+#define MEMORY_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct MemoryArena MemoryArena;
+
+// Slices are handed out zeroed and aligned to a cache line. Nothing is freed
+// until the whole arena is
+size_t memory_arena_get_slice_size(size_t size);
+MemoryArena *memory_arena_initialize(size_t capacity);
+void memory_arena_free(MemoryArena *self);
+void *memory_arena_allocate(MemoryArena *self, size_t size);
+bool memory_arena_lock(MemoryArena *self);
+
+#endif
@@ -19,20 +19,33 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
 #include "noise_profile_state.h"
+#include "lv2/atom/atom.h"
+#include <stdbool.h>
 
-#define MAX_PROFILE_SIZE 8192
+// Blobs written by older versions always held this many elements
+#define LEGACY_PROFILE_SIZE 8192U
 
 struct NoiseProfileState {
-  uint32_t child_size;
-  uint32_t child_type;
-  float elements[MAX_PROFILE_SIZE];
-}; // LV2 Atoms Vector Specification
+  uint32_t profile_size;
+  LV2_Atom_Vector_Body body;
+  float elements[];
+}; // Body and elements follow the LV2 Atoms Vector Specification
 
-NoiseProfileState *noise_profile_state_initialize(LV2_URID child_type) {
-  NoiseProfileState *self =
-      (NoiseProfileState *)calloc(1U, sizeof(NoiseProfileState));
-  self->child_type = (uint32_t)child_type;
-  self->child_size = (uint32_t)sizeof(float);
+static size_t get_body_size(const uint32_t profile_size) {
+  return sizeof(LV2_Atom_Vector_Body) + sizeof(float) * (size_t)profile_size;
+}
+
+NoiseProfileState *noise_profile_state_initialize(const LV2_URID child_type,
+                                                  const uint32_t profile_size) {
+  NoiseProfileState *self = (NoiseProfileState *)calloc(
+      1U, sizeof(NoiseProfileState) + sizeof(float) * (size_t)profile_size);
+  if (!self) {
+    return NULL;
+  }
+
+  self->profile_size = profile_size;
+  self->body.child_type = (uint32_t)child_type;
+  self->body.child_size = (uint32_t)sizeof(float);
 
   return self;
 }
@@ -42,4 +55,35 @@ void noise_profile_state_free(NoiseProfileState *self) { free(self); }
 float *noise_profile_get_elements(NoiseProfileState *self) {
   return self->elements;
 }
-size_t noise_profile_get_size() { return sizeof(NoiseProfileState); }
\ No newline at end of file
+
+const void *noise_profile_get_body(const NoiseProfileState *self) {
+  return &self->body;
+}
+
+// Only the meaningful bins are stored
+size_t noise_profile_get_size(const NoiseProfileState *self) {
+  return get_body_size(self->profile_size);
+}
+
+// Returns the stored elements of a saved body holding a profile of the given
+// size, either in the compact layout or in the fixed size legacy one
+const float *noise_profile_state_read(const void *body, const size_t size,
+                                      const uint32_t profile_size) {
+  if (!body || size < sizeof(LV2_Atom_Vector_Body)) {
+    return NULL;
+  }
+
+  const LV2_Atom_Vector_Body *vector_body = (const LV2_Atom_Vector_Body *)body;
+  if (vector_body->child_size != sizeof(float)) {
+    return NULL;
+  }
+
+  const bool compact = size == get_body_size(profile_size);
+  const bool legacy = size == get_body_size(LEGACY_PROFILE_SIZE) &&
+                      profile_size <= LEGACY_PROFILE_SIZE;
+  if (!compact && !legacy) {
+    return NULL;
+  }
+
+  return (const float *)(vector_body + 1);
+}
@@ -0,0 +1,50 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "planner_lock.h"
+#include <pthread.h>
+
+#if defined(HAVE_FFTW_THREADS)
+#include <fftw3.h>
+#endif
+
+// libspecbleach plans its FFTs with FFTW, whose planner keeps process wide
+// tables and is not thread safe. With its threads library FFTW locks the
+// planner itself, for every plugin in the process that links the same FFTW.
+// The lock here is only shared by the instances of this library, which is all
+// it needs to cover on builds that link FFTW statically
+static pthread_mutex_t planner_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#if defined(HAVE_FFTW_THREADS)
+static pthread_once_t planner_once = PTHREAD_ONCE_INIT;
+
+static void make_planner_thread_safe(void) {
+  fftwf_make_planner_thread_safe();
+}
+#endif
+
+void planner_lock_acquire(void) {
+#if defined(HAVE_FFTW_THREADS)
+  pthread_once(&planner_once, make_planner_thread_safe);
+#endif
+  pthread_mutex_lock(&planner_mutex);
+}
+
+void planner_lock_release(void) { pthread_mutex_unlock(&planner_mutex); }
@@ -0,0 +1,133 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "processing_monitor.h"
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+// The peak covers about the last second, split in slots that expire in turn
+#define PEAK_WINDOW_SLOTS 8U
+#define REDUCTION_TIME_CONSTANT_S 0.3F
+#define ENERGY_FLOOR 1e-12F
+
+struct ProcessingMonitor {
+  float sample_rate;
+  uint64_t cycle_start_ns;
+  float cycle_time;
+
+  float peak_slots[PEAK_WINDOW_SLOTS];
+  uint32_t current_slot;
+  uint32_t slot_length;
+  uint32_t slot_samples;
+
+  float input_energy;
+  float output_energy;
+};
+
+static uint64_t get_time_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+ProcessingMonitor *processing_monitor_initialize(const uint32_t sample_rate) {
+  ProcessingMonitor *self =
+      (ProcessingMonitor *)calloc(1U, sizeof(ProcessingMonitor));
+  if (!self) {
+    return NULL;
+  }
+
+  self->sample_rate = (float)sample_rate;
+  self->slot_length = sample_rate / PEAK_WINDOW_SLOTS;
+
+  return self;
+}
+
+void processing_monitor_free(ProcessingMonitor *self) { free(self); }
+
+void processing_monitor_start_cycle(ProcessingMonitor *self) {
+  self->cycle_start_ns = get_time_ns();
+}
+
+void processing_monitor_end_cycle(ProcessingMonitor *self,
+                                  const uint32_t number_of_samples) {
+  self->cycle_time = (float)(get_time_ns() - self->cycle_start_ns) / 1e6F;
+
+  if (self->slot_samples >= self->slot_length) {
+    self->current_slot = (self->current_slot + 1U) % PEAK_WINDOW_SLOTS;
+    self->peak_slots[self->current_slot] = 0.F;
+    self->slot_samples = 0U;
+  }
+
+  if (self->cycle_time > self->peak_slots[self->current_slot]) {
+    self->peak_slots[self->current_slot] = self->cycle_time;
+  }
+  self->slot_samples += number_of_samples;
+}
+
+static float get_energy(const uint32_t number_of_samples,
+                        const float *signal) {
+  float energy = 0.F;
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    energy += signal[k] * signal[k];
+  }
+  return energy;
+}
+
+// Energies are compared without latency compensation, which is accurate
+// enough once averaged over a few hundred milliseconds
+void processing_monitor_measure_reduction(ProcessingMonitor *self,
+                                          const uint32_t number_of_samples,
+                                          const uint32_t number_of_channels,
+                                          const float *const *inputs,
+                                          const float *const *outputs) {
+  const float decay = expf(-(float)number_of_samples /
+                           (REDUCTION_TIME_CONSTANT_S * self->sample_rate));
+
+  self->input_energy *= decay;
+  self->output_energy *= decay;
+
+  for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+    self->input_energy += get_energy(number_of_samples, inputs[channel]);
+    self->output_energy += get_energy(number_of_samples, outputs[channel]);
+  }
+}
+
+float processing_monitor_get_cycle_time(const ProcessingMonitor *self) {
+  return self->cycle_time;
+}
+
+float processing_monitor_get_peak_cycle_time(const ProcessingMonitor *self) {
+  float peak = 0.F;
+  for (uint32_t i = 0U; i < PEAK_WINDOW_SLOTS; i++) {
+    if (self->peak_slots[i] > peak) {
+      peak = self->peak_slots[i];
+    }
+  }
+  return peak;
+}
+
+float processing_monitor_get_reduction(const ProcessingMonitor *self) {
+  return 10.F * log10f((self->input_energy + ENERGY_FLOOR) /
+                       (self->output_energy + ENERGY_FLOOR));
+}
@@ -0,0 +1,42 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef PROCESSING_MONITOR_H
+#define PROCESSING_MONITOR_H
+
+#include <stdint.h>
+
+typedef struct ProcessingMonitor ProcessingMonitor;
+
+ProcessingMonitor *processing_monitor_initialize(uint32_t sample_rate);
+void processing_monitor_free(ProcessingMonitor *self);
+void processing_monitor_start_cycle(ProcessingMonitor *self);
+void processing_monitor_end_cycle(ProcessingMonitor *self,
+                                  uint32_t number_of_samples);
+void processing_monitor_measure_reduction(ProcessingMonitor *self,
+                                          uint32_t number_of_samples,
+                                          uint32_t number_of_channels,
+                                          const float *const *inputs,
+                                          const float *const *outputs);
+float processing_monitor_get_cycle_time(const ProcessingMonitor *self);
+float processing_monitor_get_peak_cycle_time(const ProcessingMonitor *self);
+float processing_monitor_get_reduction(const ProcessingMonitor *self);
+
+#endif
@@ -0,0 +1,337 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _GNU_SOURCE
+
+#include "processing_pool.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+typedef dispatch_semaphore_t Semaphore;
+
+static bool semaphore_init(Semaphore *semaphore) {
+  *semaphore = dispatch_semaphore_create(0);
+  return *semaphore != NULL;
+}
+static void semaphore_destroy(Semaphore *semaphore) {
+  dispatch_release(*semaphore);
+}
+static void semaphore_post(Semaphore *semaphore) {
+  dispatch_semaphore_signal(*semaphore);
+}
+static void semaphore_wait(Semaphore *semaphore) {
+  dispatch_semaphore_wait(*semaphore, DISPATCH_TIME_FOREVER);
+}
+#else
+#include <semaphore.h>
+typedef sem_t Semaphore;
+
+static bool semaphore_init(Semaphore *semaphore) {
+  return sem_init(semaphore, 0, 0U) == 0;
+}
+static void semaphore_destroy(Semaphore *semaphore) { sem_destroy(semaphore); }
+static void semaphore_post(Semaphore *semaphore) { sem_post(semaphore); }
+static void semaphore_wait(Semaphore *semaphore) {
+  while (sem_wait(semaphore) != 0) {
+  }
+}
+#endif
+
+typedef struct Worker {
+  pthread_t thread;
+  Semaphore wake;
+  ProcessingPool *pool;
+  bool started;
+} Worker;
+
+// Claims pack the dispatch generation, its number of tasks and the next task
+#define CLAIM_INDEX_BITS 20U
+#define CLAIM_TASKS_SHIFT CLAIM_INDEX_BITS
+#define CLAIM_GENERATION_SHIFT (2U * CLAIM_INDEX_BITS)
+#define CLAIM_INDEX_MASK ((UINT64_C(1) << CLAIM_INDEX_BITS) - 1U)
+#define MAXIMUM_TASKS ((uint32_t)CLAIM_INDEX_MASK)
+
+// Rounds the dispatching thread spins on the cpu for helpers to finish their
+// tasks before it starts yielding it
+#define SPIN_LIMIT 4096U
+
+struct ProcessingPool {
+  Worker *workers;
+  uint32_t number_of_workers;
+  uint64_t generation;
+
+  _Atomic(ProcessingTask) task;
+  _Atomic(void *) data;
+  _Atomic(uint64_t) claim;
+  atomic_uint finished_tasks;
+  atomic_bool quit;
+  atomic_flag busy;
+  bool priority_adopted;
+};
+
+// Instances of the library share one set of helpers, so running many of them
+// never starts more threads than there are cores
+static pthread_mutex_t shared_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ProcessingPool *shared_pool;
+static uint32_t shared_pool_users;
+
+uint32_t processing_pool_get_number_of_cpus(void) {
+#if defined(_WIN32)
+  SYSTEM_INFO system_info;
+  GetSystemInfo(&system_info);
+  const long number_of_cpus = (long)system_info.dwNumberOfProcessors;
+#else
+  const long number_of_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return number_of_cpus > 1 ? (uint32_t)number_of_cpus : 1U;
+}
+
+static void relax_cpu(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+// A claim only succeeds while the dispatch it was read from still has tasks
+// left, so a helper waking late never runs a task of the next one
+static void run_tasks(ProcessingPool *self) {
+  uint64_t claim = atomic_load_explicit(&self->claim, memory_order_acquire);
+
+  for (;;) {
+    const uint32_t task_index = (uint32_t)(claim & CLAIM_INDEX_MASK);
+    const uint32_t number_of_tasks =
+        (uint32_t)((claim >> CLAIM_TASKS_SHIFT) & CLAIM_INDEX_MASK);
+    if (task_index >= number_of_tasks) {
+      return;
+    }
+
+    const ProcessingTask task =
+        atomic_load_explicit(&self->task, memory_order_relaxed);
+    void *data = atomic_load_explicit(&self->data, memory_order_relaxed);
+
+    if (atomic_compare_exchange_weak_explicit(&self->claim, &claim, claim + 1U,
+                                              memory_order_acq_rel,
+                                              memory_order_acquire)) {
+      task(data, task_index);
+      atomic_fetch_add_explicit(&self->finished_tasks, 1U,
+                                memory_order_release);
+      claim = atomic_load_explicit(&self->claim, memory_order_acquire);
+    }
+  }
+}
+
+static void *worker_loop(void *data) {
+  Worker *worker = (Worker *)data;
+  ProcessingPool *pool = worker->pool;
+
+  for (;;) {
+    semaphore_wait(&worker->wake);
+    if (atomic_load(&pool->quit)) {
+      break;
+    }
+
+    run_tasks(pool);
+  }
+
+  return NULL;
+}
+
+// Helpers inherit the scheduling class of the thread that dispatches work,
+// which is the host audio thread and unknown until the first cycle
+static void adopt_caller_priority(ProcessingPool *self) {
+  int policy = 0;
+  struct sched_param parameters;
+
+  if (pthread_getschedparam(pthread_self(), &policy, &parameters) != 0) {
+    return;
+  }
+
+  for (uint32_t i = 0U; i < self->number_of_workers; i++) {
+    pthread_setschedparam(self->workers[i].thread, policy, &parameters);
+  }
+}
+
+ProcessingPool *processing_pool_initialize(const uint32_t number_of_workers) {
+  if (number_of_workers == 0U) {
+    return NULL;
+  }
+
+  ProcessingPool *self = (ProcessingPool *)calloc(1U, sizeof(ProcessingPool));
+  if (!self) {
+    return NULL;
+  }
+
+  atomic_init(&self->task, NULL);
+  atomic_init(&self->data, NULL);
+  atomic_init(&self->claim, 0U);
+  atomic_init(&self->finished_tasks, 0U);
+  atomic_init(&self->quit, false);
+  atomic_flag_clear(&self->busy);
+
+  self->workers = (Worker *)calloc(number_of_workers, sizeof(Worker));
+  if (!self->workers) {
+    processing_pool_free(self);
+    return NULL;
+  }
+
+  for (uint32_t i = 0U; i < number_of_workers; i++) {
+    Worker *worker = &self->workers[i];
+    worker->pool = self;
+
+    if (!semaphore_init(&worker->wake)) {
+      processing_pool_free(self);
+      return NULL;
+    }
+    self->number_of_workers++;
+
+    if (pthread_create(&worker->thread, NULL, worker_loop, worker) != 0) {
+      processing_pool_free(self);
+      return NULL;
+    }
+    worker->started = true;
+  }
+
+  return self;
+}
+
+void processing_pool_free(ProcessingPool *self) {
+  if (!self) {
+    return;
+  }
+
+  atomic_store(&self->quit, true);
+
+  for (uint32_t i = 0U; i < self->number_of_workers; i++) {
+    Worker *worker = &self->workers[i];
+    if (worker->started) {
+      semaphore_post(&worker->wake);
+      pthread_join(worker->thread, NULL);
+    }
+    semaphore_destroy(&worker->wake);
+  }
+
+  free(self->workers);
+  free(self);
+}
+
+// Helpers are left to the scheduler, which keeps them off the core the audio
+// thread is busy on. There is no pool on a single core
+ProcessingPool *processing_pool_acquire(void) {
+  pthread_mutex_lock(&shared_pool_mutex);
+  if (shared_pool_users == 0U) {
+    const uint32_t number_of_cpus = processing_pool_get_number_of_cpus();
+    shared_pool = number_of_cpus > 1U
+                      ? processing_pool_initialize(number_of_cpus - 1U)
+                      : NULL;
+  }
+  if (shared_pool) {
+    shared_pool_users++;
+  }
+  ProcessingPool *pool = shared_pool;
+  pthread_mutex_unlock(&shared_pool_mutex);
+
+  return pool;
+}
+
+void processing_pool_release(ProcessingPool *self) {
+  if (!self) {
+    return;
+  }
+
+  pthread_mutex_lock(&shared_pool_mutex);
+  if (shared_pool_users > 0U && --shared_pool_users == 0U) {
+    processing_pool_free(shared_pool);
+    shared_pool = NULL;
+  }
+  pthread_mutex_unlock(&shared_pool_mutex);
+}
+
+uint32_t processing_pool_get_number_of_workers(const ProcessingPool *self) {
+  return self ? self->number_of_workers : 0U;
+}
+
+// Helpers are woken without blocking and whatever they have not claimed yet is
+// run by the calling thread, which only ever waits on tasks already running.
+// While another thread is dispatching, nothing is run and the caller is left to
+// run the tasks itself
+bool processing_pool_run(ProcessingPool *self, const uint32_t number_of_tasks,
+                         ProcessingTask task, void *data) {
+  if (!self || !task || number_of_tasks == 0U ||
+      number_of_tasks > MAXIMUM_TASKS) {
+    return false;
+  }
+
+  if (atomic_flag_test_and_set_explicit(&self->busy, memory_order_acquire)) {
+    return false;
+  }
+
+  if (!self->priority_adopted) {
+    adopt_caller_priority(self);
+    self->priority_adopted = true;
+  }
+
+  self->generation++;
+  atomic_store_explicit(&self->task, task, memory_order_relaxed);
+  atomic_store_explicit(&self->data, data, memory_order_relaxed);
+  atomic_store_explicit(&self->finished_tasks, 0U, memory_order_relaxed);
+  atomic_store_explicit(&self->claim,
+                        (self->generation << CLAIM_GENERATION_SHIFT) |
+                            ((uint64_t)number_of_tasks << CLAIM_TASKS_SHIFT),
+                        memory_order_release);
+
+  // The calling thread takes tasks as well, so one helper less is needed
+  uint32_t helpers = number_of_tasks - 1U;
+  if (helpers > self->number_of_workers) {
+    helpers = self->number_of_workers;
+  }
+
+  for (uint32_t i = 0U; i < helpers; i++) {
+    semaphore_post(&self->workers[i].wake);
+  }
+
+  run_tasks(self);
+
+  for (uint32_t spin = 0U;
+       atomic_load_explicit(&self->finished_tasks, memory_order_acquire) <
+       number_of_tasks;
+       spin++) {
+    if (spin < SPIN_LIMIT) {
+      relax_cpu();
+    } else {
+      sched_yield();
+    }
+  }
+
+  atomic_flag_clear_explicit(&self->busy, memory_order_release);
+
+  return true;
+}
@@ -0,0 +1,41 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef PROCESSING_POOL_H
+#define PROCESSING_POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef void (*ProcessingTask)(void *data, uint32_t task_index);
+
+typedef struct ProcessingPool ProcessingPool;
+
+ProcessingPool *processing_pool_initialize(uint32_t number_of_workers);
+void processing_pool_free(ProcessingPool *self);
+// The pool shared by every instance, held until each of them released it
+ProcessingPool *processing_pool_acquire(void);
+void processing_pool_release(ProcessingPool *self);
+uint32_t processing_pool_get_number_of_workers(const ProcessingPool *self);
+uint32_t processing_pool_get_number_of_cpus(void);
+bool processing_pool_run(ProcessingPool *self, uint32_t number_of_tasks,
+                         ProcessingTask task, void *data);
+
+#endif
@@ -0,0 +1,55 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "profile_resampler.h"
+
+// Maps a noise power spectrum to the bins of another spectrum size and sample
+// rate. Bins past the Nyquist frequency of the input repeat its last bin
+void profile_resampler_run(const float *input, const uint32_t input_size,
+                           const float input_sample_rate, float *output,
+                           const uint32_t output_size,
+                           const float output_sample_rate) {
+  if (input_size < 2U || output_size < 2U) {
+    return;
+  }
+
+  const float input_bins = (float)(input_size - 1U);
+  const float output_bins = (float)(output_size - 1U);
+  const float step =
+      (output_sample_rate * input_bins) / (input_sample_rate * output_bins);
+
+  // The denoiser FFT is unnormalized, so the power of a bin grows with both
+  // the transform size and the sample rate of the same noise
+  const float gain =
+      (output_sample_rate * output_bins) / (input_sample_rate * input_bins);
+
+  for (uint32_t k = 0U; k < output_size; k++) {
+    const float position = (float)k * step;
+    if (position >= input_bins) {
+      output[k] = gain * input[input_size - 1U];
+      continue;
+    }
+
+    const uint32_t bin = (uint32_t)position;
+    const float fraction = position - (float)bin;
+    output[k] =
+        gain * (input[bin] + fraction * (input[bin + 1U] - input[bin]));
+  }
+}
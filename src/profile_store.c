@@ -0,0 +1,262 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "profile_store.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct SharedProfile {
+  SharedProfile *next;
+  uint32_t hash;
+  atomic_uint references;
+  uint32_t profile_size;
+  uint32_t number_of_profiles;
+  uint32_t averaged_blocks;
+  float *noise_profiles;
+};
+
+// Noise profiles shared by every instance loaded in the process, so one learn
+// pass serves all the tracks that suffer the same noise
+typedef struct ProfileSlot {
+  const SharedProfile *profile;
+  atomic_uint version;
+} ProfileSlot;
+
+static pthread_mutex_t store_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ProfileSlot slots[PROFILE_STORE_SLOTS];
+static SharedProfile *shared_profiles;
+static uint32_t number_of_users;
+
+static ProfileSlot *get_slot(const uint32_t slot) {
+  return slot > 0U && slot <= PROFILE_STORE_SLOTS ? &slots[slot - 1U] : NULL;
+}
+
+static uint32_t hash_bytes(uint32_t hash, const void *data, const size_t size) {
+  const unsigned char *bytes = (const unsigned char *)data;
+  for (size_t k = 0U; k < size; k++) {
+    hash = (hash ^ bytes[k]) * 16777619U;
+  }
+  return hash;
+}
+
+// FNV-1a over the profile values and what they were averaged from
+static uint32_t hash_profiles(const uint32_t profile_size,
+                              const uint32_t number_of_profiles,
+                              const float *const *noise_profiles,
+                              const uint32_t averaged_blocks) {
+  uint32_t hash = 2166136261U;
+  hash = hash_bytes(hash, &profile_size, sizeof(uint32_t));
+  hash = hash_bytes(hash, &number_of_profiles, sizeof(uint32_t));
+  hash = hash_bytes(hash, &averaged_blocks, sizeof(uint32_t));
+  for (uint32_t k = 0U; k < number_of_profiles; k++) {
+    hash = hash_bytes(hash, noise_profiles[k], sizeof(float) * profile_size);
+  }
+  return hash;
+}
+
+static bool matches_profiles(const SharedProfile *self, const uint32_t hash,
+                             const uint32_t profile_size,
+                             const uint32_t number_of_profiles,
+                             const float *const *noise_profiles,
+                             const uint32_t averaged_blocks) {
+  if (self->hash != hash || self->profile_size != profile_size ||
+      self->number_of_profiles != number_of_profiles ||
+      self->averaged_blocks != averaged_blocks) {
+    return false;
+  }
+
+  for (uint32_t k = 0U; k < number_of_profiles; k++) {
+    if (memcmp(&self->noise_profiles[k * profile_size], noise_profiles[k],
+               sizeof(float) * profile_size) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Unsharing only drops the count, so it can be done from the audio thread.
+// Profiles nobody holds are freed the next time the store is locked
+static void collect_unshared(const bool everything) {
+  SharedProfile **link = &shared_profiles;
+  while (*link) {
+    SharedProfile *profile = *link;
+    if (everything || atomic_load(&profile->references) == 0U) {
+      *link = profile->next;
+      free(profile->noise_profiles);
+      free(profile);
+    } else {
+      link = &profile->next;
+    }
+  }
+}
+
+// Expects the store to be locked
+static const SharedProfile *share_locked(const uint32_t profile_size,
+                                         const uint32_t number_of_profiles,
+                                         const float *const *noise_profiles,
+                                         const uint32_t averaged_blocks) {
+  collect_unshared(false);
+
+  const uint32_t hash = hash_profiles(profile_size, number_of_profiles,
+                                      noise_profiles, averaged_blocks);
+
+  for (SharedProfile *profile = shared_profiles; profile;
+       profile = profile->next) {
+    if (matches_profiles(profile, hash, profile_size, number_of_profiles,
+                         noise_profiles, averaged_blocks)) {
+      atomic_fetch_add(&profile->references, 1U);
+      return profile;
+    }
+  }
+
+  SharedProfile *profile = (SharedProfile *)calloc(1U, sizeof(SharedProfile));
+  if (!profile) {
+    return NULL;
+  }
+  profile->noise_profiles =
+      (float *)malloc(sizeof(float) * profile_size * number_of_profiles);
+  if (!profile->noise_profiles) {
+    free(profile);
+    return NULL;
+  }
+
+  for (uint32_t k = 0U; k < number_of_profiles; k++) {
+    memcpy(&profile->noise_profiles[k * profile_size], noise_profiles[k],
+           sizeof(float) * profile_size);
+  }
+  profile->hash = hash;
+  atomic_init(&profile->references, 1U);
+  profile->profile_size = profile_size;
+  profile->number_of_profiles = number_of_profiles;
+  profile->averaged_blocks = averaged_blocks;
+
+  profile->next = shared_profiles;
+  shared_profiles = profile;
+
+  return profile;
+}
+
+void profile_store_acquire(void) {
+  pthread_mutex_lock(&store_mutex);
+  number_of_users++;
+  pthread_mutex_unlock(&store_mutex);
+}
+
+// Slots are kept while any instance is alive, they go with the last one
+// along with what was left in messages no worker answered
+void profile_store_release(void) {
+  pthread_mutex_lock(&store_mutex);
+  if (number_of_users > 0U && --number_of_users == 0U) {
+    for (uint32_t k = 0U; k < PROFILE_STORE_SLOTS; k++) {
+      slots[k].profile = NULL;
+    }
+    collect_unshared(true);
+  }
+  pthread_mutex_unlock(&store_mutex);
+}
+
+const SharedProfile *profile_store_share(const uint32_t profile_size,
+                                         const uint32_t number_of_profiles,
+                                         const float *const *noise_profiles,
+                                         const uint32_t averaged_blocks) {
+  if (profile_size == 0U || number_of_profiles == 0U) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&store_mutex);
+  const SharedProfile *profile = share_locked(
+      profile_size, number_of_profiles, noise_profiles, averaged_blocks);
+  pthread_mutex_unlock(&store_mutex);
+
+  return profile;
+}
+
+void profile_store_unshare(const SharedProfile *profile) {
+  if (profile) {
+    atomic_fetch_sub(&((SharedProfile *)profile)->references, 1U);
+  }
+}
+
+// Users with more channels than the profile reuse its first one for the extra
+const float *profile_store_get_profile(const SharedProfile *profile,
+                                       const uint32_t index) {
+  const uint32_t k = index < profile->number_of_profiles ? index : 0U;
+  return &profile->noise_profiles[k * profile->profile_size];
+}
+
+uint32_t profile_store_get_averaged_blocks(const SharedProfile *profile) {
+  return profile->averaged_blocks;
+}
+
+uint32_t profile_store_get_version(const uint32_t slot) {
+  const ProfileSlot *profile_slot = get_slot(slot);
+  return profile_slot ? atomic_load(&profile_slot->version) : 0U;
+}
+
+// Returns the version of the slot after publishing, 0 if nothing was stored
+uint32_t profile_store_publish(const uint32_t slot,
+                               const uint32_t profile_size,
+                               const uint32_t number_of_profiles,
+                               const float *const *noise_profiles,
+                               const uint32_t averaged_blocks) {
+  ProfileSlot *profile_slot = get_slot(slot);
+  if (!profile_slot || profile_size == 0U || number_of_profiles == 0U) {
+    return 0U;
+  }
+
+  pthread_mutex_lock(&store_mutex);
+  const SharedProfile *profile = share_locked(
+      profile_size, number_of_profiles, noise_profiles, averaged_blocks);
+  uint32_t version = 0U;
+  if (profile) {
+    profile_store_unshare(profile_slot->profile);
+    profile_slot->profile = profile;
+    version = atomic_fetch_add(&profile_slot->version, 1U) + 1U;
+  }
+  pthread_mutex_unlock(&store_mutex);
+
+  return version;
+}
+
+// The profile comes with a reference of its own. Profiles learned at another
+// sample rate are left out
+const SharedProfile *profile_store_fetch(const uint32_t slot,
+                                         const uint32_t profile_size,
+                                         uint32_t *version) {
+  ProfileSlot *profile_slot = get_slot(slot);
+  if (!profile_slot) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&store_mutex);
+  collect_unshared(false);
+  *version = atomic_load(&profile_slot->version);
+  SharedProfile *profile = (SharedProfile *)profile_slot->profile;
+  if (profile && profile->profile_size == profile_size) {
+    atomic_fetch_add(&profile->references, 1U);
+  } else {
+    profile = NULL;
+  }
+  pthread_mutex_unlock(&store_mutex);
+
+  return profile;
+}
@@ -0,0 +1,56 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef PROFILE_STORE_H
+#define PROFILE_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PROFILE_STORE_SLOTS 16U
+
+typedef struct SharedProfile SharedProfile;
+
+void profile_store_acquire(void);
+void profile_store_release(void);
+
+// Identical profiles are stored once, found by a hash of their content. Each
+// share takes a reference to a read only copy that unshare gives back, which
+// never locks
+const SharedProfile *profile_store_share(uint32_t profile_size,
+                                         uint32_t number_of_profiles,
+                                         const float *const *noise_profiles,
+                                         uint32_t averaged_blocks);
+void profile_store_unshare(const SharedProfile *profile);
+const float *profile_store_get_profile(const SharedProfile *profile,
+                                       uint32_t index);
+uint32_t profile_store_get_averaged_blocks(const SharedProfile *profile);
+
+// Slots are numbered from 1, 0 standing for no slot. Only the version can be
+// read from the audio thread
+uint32_t profile_store_get_version(uint32_t slot);
+uint32_t profile_store_publish(uint32_t slot, uint32_t profile_size,
+                               uint32_t number_of_profiles,
+                               const float *const *noise_profiles,
+                               uint32_t averaged_blocks);
+const SharedProfile *profile_store_fetch(uint32_t slot, uint32_t profile_size,
+                                         uint32_t *version);
+
+#endif
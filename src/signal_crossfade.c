@@ -24,26 +24,87 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <stdlib.h>
 #include <string.h>
 
-#ifndef M_PI
-#define M_PI 3.1415926535F
-#endif
-
 #define RELEASE_TIME_MS 30.F
+#define SETTLED_THRESHOLD 1e-5F
+#define RAMP_CHUNK_SIZE 64U
+
+typedef void (*BlendFunction)(uint32_t number_of_samples,
+                              const float *restrict ramp,
+                              const float *restrict input,
+                              float *restrict output);
 
 struct SignalCrossfade {
+  BlendFunction blend;
   float tau;
   float wet_dry_target;
   float wet_dry;
+  float ramp[RAMP_CHUNK_SIZE];
 };
 
+static inline void blend_samples(const uint32_t number_of_samples,
+                                 const float *restrict ramp,
+                                 const float *restrict input,
+                                 float *restrict output) {
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    output[k] = input[k] + ramp[k] * (output[k] - input[k]);
+  }
+}
+
+static void blend(const uint32_t number_of_samples,
+                  const float *restrict ramp, const float *restrict input,
+                  float *restrict output) {
+  blend_samples(number_of_samples, ramp, input, output);
+}
+
+// Wider variants of the blend are built next to the baseline one and picked
+// from what the running cpu supports. The baseline already covers NEON
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAS_BLEND_VARIANTS
+
+__attribute__((target("avx2,fma"))) static void
+blend_avx2(const uint32_t number_of_samples, const float *restrict ramp,
+           const float *restrict input, float *restrict output) {
+  blend_samples(number_of_samples, ramp, input, output);
+}
+
+// Only gcc takes the vector width as a target option, clang rejects it
+#if defined(__clang__)
+#define AVX512_TARGET "avx512f"
+#else
+#define AVX512_TARGET "avx512f,prefer-vector-width=512"
+#endif
+
+__attribute__((target(AVX512_TARGET))) static void
+blend_avx512(const uint32_t number_of_samples, const float *restrict ramp,
+             const float *restrict input, float *restrict output) {
+  blend_samples(number_of_samples, ramp, input, output);
+}
+#endif
+
+static BlendFunction select_blend(void) {
+#if defined(HAS_BLEND_VARIANTS)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return blend_avx512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return blend_avx2;
+  }
+#endif
+  return blend;
+}
+
 SignalCrossfade *signal_crossfade_initialize(const uint32_t sample_rate) {
   SignalCrossfade *self =
       (SignalCrossfade *)calloc(1U, sizeof(SignalCrossfade));
 
+  // One pole smoothing applied per sample so fades last the same regardless
+  // of the host block size
   self->tau =
-      (1.F - expf(-128.F * M_PI * RELEASE_TIME_MS / (float)sample_rate));
+      (1.F - expf(-1000.F / (RELEASE_TIME_MS * (float)sample_rate)));
   self->wet_dry = 0.F;
   self->wet_dry_target = 0.F;
+  self->blend = select_blend();
 
   return self;
 }
@@ -57,22 +118,80 @@ static void signal_crossfade_update_wetdry_target(SignalCrossfade *self,
   } else {
     self->wet_dry_target = 0.F;
   }
+}
+
+static bool signal_crossfade_is_settled(const SignalCrossfade *self) {
+  return self->wet_dry == self->wet_dry_target;
+}
+
+bool signal_crossfade_is_dry(const SignalCrossfade *self) {
+  return self->wet_dry_target == 0.F && signal_crossfade_is_settled(self);
+}
+
+// For when the wet signal can no longer be trusted, so there is no fade
+void signal_crossfade_cut_to_dry(SignalCrossfade *self) {
+  self->wet_dry = 0.F;
+  self->wet_dry_target = 0.F;
+}
+
+static void signal_crossfade_fill_ramp(SignalCrossfade *self,
+                                       const uint32_t number_of_samples) {
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    self->wet_dry += self->tau * (self->wet_dry_target - self->wet_dry);
+    self->ramp[k] = self->wet_dry;
+  }
+
+  if (fabsf(self->wet_dry_target - self->wet_dry) < SETTLED_THRESHOLD) {
+    self->wet_dry = self->wet_dry_target;
+  }
+}
 
-  self->wet_dry += self->tau * (self->wet_dry_target - self->wet_dry);
+static void copy_dry(const uint32_t number_of_samples, const float *input,
+                     float *output) {
+  if (input != output) {
+    memcpy(output, input, sizeof(float) * number_of_samples);
+  }
 }
 
 bool signal_crossfade_run(SignalCrossfade *self,
-                          const uint32_t number_of_samples, const float *input,
-                          float *output, const bool enable) {
-  if (!input || !output || number_of_samples <= 0U) {
+                          const uint32_t number_of_samples,
+                          const uint32_t number_of_channels,
+                          const float *const *input, float *const *output,
+                          const bool enable) {
+  if (!input || !output || number_of_samples <= 0U ||
+      number_of_channels <= 0U) {
     return false;
   }
 
   signal_crossfade_update_wetdry_target(self, enable);
 
-  for (uint32_t k = 0U; k < number_of_samples; k++) {
-    output[k] = (1.F - self->wet_dry) * input[k] + output[k] * self->wet_dry;
+  uint32_t offset = 0U;
+  while (offset < number_of_samples) {
+    // Once settled the whole remainder of the block is either wet or dry
+    if (signal_crossfade_is_settled(self)) {
+      if (self->wet_dry == 0.F) {
+        for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+          copy_dry(number_of_samples - offset, &input[channel][offset],
+                   &output[channel][offset]);
+        }
+      }
+      break;
+    }
+
+    uint32_t chunk_size = number_of_samples - offset;
+    if (chunk_size > RAMP_CHUNK_SIZE) {
+      chunk_size = RAMP_CHUNK_SIZE;
+    }
+
+    signal_crossfade_fill_ramp(self, chunk_size);
+
+    for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+      self->blend(chunk_size, self->ramp, &input[channel][offset],
+                  &output[channel][offset]);
+    }
+
+    offset += chunk_size;
   }
 
   return true;
-}
\ No newline at end of file
+}
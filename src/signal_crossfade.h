@@ -28,6 +28,10 @@ typedef struct SignalCrossfade SignalCrossfade;
 
 SignalCrossfade *signal_crossfade_initialize(uint32_t sample_rate);
 void signal_crossfade_free(SignalCrossfade *self);
+bool signal_crossfade_is_dry(const SignalCrossfade *self);
+void signal_crossfade_cut_to_dry(SignalCrossfade *self);
 bool signal_crossfade_run(SignalCrossfade *self, uint32_t number_of_samples,
-                          const float *input, float *output, bool enable);
+                          uint32_t number_of_channels,
+                          const float *const *input, float *const *output,
+                          bool enable);
 #endif
\ No newline at end of file
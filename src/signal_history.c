@@ -0,0 +1,138 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "signal_history.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Keeps the most recent samples of a signal in a ring. The audio thread writes
+// it while other threads may read it, the writer never waits and drops a block
+// instead when a read is in progress
+struct SignalHistory {
+  uint32_t length;
+  uint32_t size;
+  uint32_t write_position;
+  float *samples;
+  atomic_uint readers;
+  atomic_bool writing;
+};
+
+SignalHistory *signal_history_initialize(const uint32_t length) {
+  if (length == 0U) {
+    return NULL;
+  }
+
+  SignalHistory *self = (SignalHistory *)calloc(1U, sizeof(SignalHistory));
+  if (!self) {
+    return NULL;
+  }
+
+  self->length = length;
+  atomic_init(&self->readers, 0U);
+  atomic_init(&self->writing, false);
+  self->samples = (float *)calloc(length, sizeof(float));
+  if (!self->samples) {
+    signal_history_free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void signal_history_free(SignalHistory *self) {
+  free(self->samples);
+  free(self);
+}
+
+uint32_t signal_history_get_length(const SignalHistory *self) {
+  return self->length;
+}
+
+static void write_samples(SignalHistory *self, uint32_t number_of_samples,
+                          const float *input) {
+  // Only the tail of blocks longer than the ring is kept
+  if (number_of_samples > self->length) {
+    input += number_of_samples - self->length;
+    number_of_samples = self->length;
+  }
+
+  const uint32_t first_part = self->length - self->write_position;
+  if (number_of_samples <= first_part) {
+    memcpy(&self->samples[self->write_position], input,
+           sizeof(float) * number_of_samples);
+  } else {
+    memcpy(&self->samples[self->write_position], input,
+           sizeof(float) * first_part);
+    memcpy(self->samples, &input[first_part],
+           sizeof(float) * (number_of_samples - first_part));
+  }
+
+  self->write_position =
+      (self->write_position + number_of_samples) % self->length;
+  self->size = self->size + number_of_samples < self->length
+                   ? self->size + number_of_samples
+                   : self->length;
+}
+
+void signal_history_write(SignalHistory *self,
+                          const uint32_t number_of_samples,
+                          const float *input) {
+  atomic_store(&self->writing, true);
+  if (atomic_load(&self->readers) == 0U) {
+    write_samples(self, number_of_samples, input);
+  }
+  atomic_store(&self->writing, false);
+}
+
+// Copies the ring oldest first to a buffer of the ring length. The samples
+// are placed at its end and their number is returned. A block being written
+// is at most as long as a cycle, so waiting for it is short
+uint32_t signal_history_read(SignalHistory *self, float *output) {
+  atomic_fetch_add(&self->readers, 1U);
+  while (atomic_load(&self->writing)) {
+  }
+
+  const uint32_t start = self->length - self->size;
+  memset(output, 0, sizeof(float) * start);
+
+  const uint32_t oldest =
+      (self->write_position + self->length - self->size) % self->length;
+  const uint32_t first_part = self->length - oldest < self->size
+                                  ? self->length - oldest
+                                  : self->size;
+
+  memcpy(&output[start], &self->samples[oldest], sizeof(float) * first_part);
+  memcpy(&output[start + first_part], self->samples,
+         sizeof(float) * (self->size - first_part));
+
+  const uint32_t size = self->size;
+  atomic_fetch_sub(&self->readers, 1U);
+
+  return size;
+}
+
+void signal_history_load(SignalHistory *self, const uint32_t number_of_samples,
+                         const float *input) {
+  self->size = 0U;
+  self->write_position = 0U;
+  write_samples(self, number_of_samples, input);
+}
@@ -0,0 +1,80 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "silence_gate.h"
+#include <math.h>
+#include <stdlib.h>
+
+// About -160 dBFS, far below any converter noise floor
+#define SILENCE_THRESHOLD 1e-8F
+
+// Counts how long the input has been silent. Once that lasts longer than the
+// hold time, whatever the denoiser still had buffered has been flushed out
+struct SilenceGate {
+  uint32_t hold_samples;
+  uint32_t silent_samples;
+};
+
+SilenceGate *silence_gate_initialize(const uint32_t latency) {
+  SilenceGate *self = (SilenceGate *)calloc(1U, sizeof(SilenceGate));
+  if (!self) {
+    return NULL;
+  }
+
+  // A frame leaving the analysis window is still overlapped into the output
+  // for another latency period
+  self->hold_samples = 2U * latency;
+
+  return self;
+}
+
+void silence_gate_free(SilenceGate *self) { free(self); }
+
+// A denoiser swapped in holds input of its own, so silence is counted again
+// from the hold time of its latency
+void silence_gate_reset(SilenceGate *self, const uint32_t latency) {
+  self->hold_samples = 2U * latency;
+  self->silent_samples = 0U;
+}
+
+static bool is_silent(const uint32_t number_of_samples, const float *input) {
+  float peak = 0.F;
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    peak = fmaxf(peak, fabsf(input[k]));
+  }
+  return peak < SILENCE_THRESHOLD;
+}
+
+// True when the block is silent and so was everything the denoiser could still
+// be holding, so that its output would be silent too
+bool silence_gate_run(SilenceGate *self, const uint32_t number_of_samples,
+                      const float *input) {
+  if (!is_silent(number_of_samples, input)) {
+    self->silent_samples = 0U;
+    return false;
+  }
+
+  const bool drained = self->silent_samples >= self->hold_samples;
+  if (!drained) {
+    self->silent_samples += number_of_samples;
+  }
+
+  return drained;
+}
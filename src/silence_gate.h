@@ -0,0 +1,35 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef SILENCE_GATE_H
+#define SILENCE_GATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct SilenceGate SilenceGate;
+
+SilenceGate *silence_gate_initialize(uint32_t latency);
+void silence_gate_free(SilenceGate *self);
+void silence_gate_reset(SilenceGate *self, uint32_t latency);
+bool silence_gate_run(SilenceGate *self, uint32_t number_of_samples,
+                      const float *input);
+
+#endif
@@ -0,0 +1,248 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "speech_band.h"
+#include "delay_line.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// The lower half of the spectrum is decimated by two for the denoiser and
+// interpolated back. The upper half skips it, and is only scaled by the
+// reduction the denoiser achieved on the lower one over the same block
+struct SpeechBand {
+  float coefficients[SPEECH_BAND_TAPS];
+  float split_history[SPEECH_BAND_TAPS];
+  float merge_history[SPEECH_BAND_TAPS];
+  uint32_t split_position;
+  uint32_t merge_position;
+  bool odd_sample;
+  bool block_starts_odd;
+  uint32_t low_band_samples;
+  uint32_t denoiser_latency;
+  float high_band_gain;
+
+  float *high_band;
+  float *delayed_high_band;
+  float *low_band;
+  float *denoised_low_band;
+  float *reference_low_band;
+  DelayLine *high_band_delay;
+  DelayLine *low_band_delay;
+};
+
+// Blackman windowed sinc cut at a quarter of the rate, every other tap but
+// the center one is zero
+static void design_halfband(float *coefficients) {
+  float sum = 0.F;
+  for (uint32_t k = 0U; k < SPEECH_BAND_TAPS; k++) {
+    const double offset = (double)k - (double)SPEECH_BAND_FILTER_DELAY;
+    const double sinc =
+        offset == 0.0 ? 0.5 : sin(0.5 * M_PI * offset) / (M_PI * offset);
+    const double phase = 2.0 * M_PI * (double)k / (SPEECH_BAND_TAPS - 1U);
+    const double window = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase);
+    coefficients[k] = (float)(sinc * window);
+    sum += coefficients[k];
+  }
+
+  for (uint32_t k = 0U; k < SPEECH_BAND_TAPS; k++) {
+    coefficients[k] /= sum;
+  }
+}
+
+SpeechBand *speech_band_initialize(const uint32_t maximum_block_length,
+                                   const uint32_t denoiser_latency) {
+  SpeechBand *self = (SpeechBand *)calloc(1U, sizeof(SpeechBand));
+  if (!self) {
+    return NULL;
+  }
+
+  design_halfband(self->coefficients);
+  self->denoiser_latency = denoiser_latency;
+  self->high_band_gain = 1.F;
+
+  const uint32_t low_band_length = maximum_block_length / 2U + 1U;
+  self->high_band = (float *)calloc(maximum_block_length, sizeof(float));
+  self->delayed_high_band =
+      (float *)calloc(maximum_block_length, sizeof(float));
+  self->low_band = (float *)calloc(low_band_length, sizeof(float));
+  self->denoised_low_band = (float *)calloc(low_band_length, sizeof(float));
+  self->reference_low_band = (float *)calloc(low_band_length, sizeof(float));
+
+  // The upper half waits for the denoiser and for the interpolation filter
+  self->high_band_delay = delay_line_initialize(2U * denoiser_latency +
+                                                SPEECH_BAND_FILTER_DELAY);
+  self->low_band_delay = delay_line_initialize(denoiser_latency);
+
+  if (!self->high_band || !self->delayed_high_band || !self->low_band ||
+      !self->denoised_low_band || !self->reference_low_band ||
+      !self->high_band_delay || !self->low_band_delay) {
+    speech_band_free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void speech_band_free(SpeechBand *self) {
+  if (self->high_band_delay) {
+    delay_line_free(self->high_band_delay);
+  }
+  if (self->low_band_delay) {
+    delay_line_free(self->low_band_delay);
+  }
+
+  free(self->high_band);
+  free(self->delayed_high_band);
+  free(self->low_band);
+  free(self->denoised_low_band);
+  free(self->reference_low_band);
+  free(self);
+}
+
+// The denoiser latency counts samples of the decimated band
+uint32_t speech_band_get_latency(const SpeechBand *self) {
+  return 2U * self->denoiser_latency + 2U * SPEECH_BAND_FILTER_DELAY;
+}
+
+static float filter(const float *coefficients, const float *history,
+                    const uint32_t position) {
+  float sum = 0.F;
+  for (uint32_t k = 0U; k < SPEECH_BAND_TAPS; k++) {
+    sum += coefficients[k] * history[(position + k) % SPEECH_BAND_TAPS];
+  }
+  return sum;
+}
+
+const float *speech_band_get_low_band(const SpeechBand *self) {
+  return self->low_band;
+}
+
+float *speech_band_get_denoised_low_band(SpeechBand *self) {
+  return self->denoised_low_band;
+}
+
+// Returns how many samples of the decimated band the block produced, which
+// alternates around half the block when its length is odd
+uint32_t speech_band_split(SpeechBand *self, const uint32_t number_of_samples,
+                           const float *input) {
+  uint32_t low_band_samples = 0U;
+  self->block_starts_odd = self->odd_sample;
+
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    self->split_history[self->split_position] = input[k];
+    self->split_position = (self->split_position + 1U) % SPEECH_BAND_TAPS;
+
+    // Oldest first, so the sample at the filter center is the delayed input
+    const float low = filter(self->coefficients, self->split_history,
+                             self->split_position);
+    const float delayed = self->split_history[(self->split_position +
+                                               SPEECH_BAND_FILTER_DELAY) %
+                                              SPEECH_BAND_TAPS];
+    self->high_band[k] = delayed - low;
+
+    if (!self->odd_sample) {
+      self->low_band[low_band_samples++] = low;
+    }
+    self->odd_sample = !self->odd_sample;
+  }
+
+  self->low_band_samples = low_band_samples;
+  return low_band_samples;
+}
+
+static float get_energy(const float *signal, const uint32_t number_of_samples) {
+  float energy = 0.F;
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    energy += signal[k] * signal[k];
+  }
+  return energy;
+}
+
+// What the denoiser removed taken off its input is the clean band
+static float get_clean_energy(const float *reference, const float *residual,
+                              const uint32_t number_of_samples) {
+  float energy = 0.F;
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    const float clean = reference[k] - residual[k];
+    energy += clean * clean;
+  }
+  return energy;
+}
+
+// The gain always follows the clean band, so the residual is inverted from
+// it once and both outputs add up to the input
+static float update_high_band_gain(SpeechBand *self,
+                                   const bool residual_listen) {
+  const uint32_t low_band_samples = self->low_band_samples;
+  delay_line_run(self->low_band_delay, low_band_samples, self->low_band,
+                 self->reference_low_band);
+
+  const float reference =
+      get_energy(self->reference_low_band, low_band_samples);
+  if (reference <= 0.F) {
+    return self->high_band_gain;
+  }
+
+  const float clean =
+      residual_listen
+          ? get_clean_energy(self->reference_low_band,
+                             self->denoised_low_band, low_band_samples)
+          : get_energy(self->denoised_low_band, low_band_samples);
+  const float gain = sqrtf(clean / reference);
+  return gain < 1.F ? gain : 1.F;
+}
+
+// Follows the split of the same block, whose phase it replays
+void speech_band_merge(SpeechBand *self, const uint32_t number_of_samples,
+                       const bool residual_listen, float *output) {
+  const float target_gain = update_high_band_gain(self, residual_listen);
+  const float gain_step =
+      (target_gain - self->high_band_gain) / (float)number_of_samples;
+
+  delay_line_run(self->high_band_delay, number_of_samples, self->high_band,
+                 self->delayed_high_band);
+
+  // Samples of the decimated band fall on the phase the split kept them at,
+  // zeros in between. Doubling them makes up for the zeros
+  bool odd_sample = self->block_starts_odd;
+  uint32_t low_band_position = 0U;
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    self->merge_history[self->merge_position] =
+        odd_sample ? 0.F
+                   : 2.F * self->denoised_low_band[low_band_position++];
+    self->merge_position = (self->merge_position + 1U) % SPEECH_BAND_TAPS;
+    odd_sample = !odd_sample;
+
+    self->high_band_gain += gain_step;
+    const float high_band_gain =
+        residual_listen ? 1.F - self->high_band_gain : self->high_band_gain;
+
+    output[k] = filter(self->coefficients, self->merge_history,
+                       self->merge_position) +
+                high_band_gain * self->delayed_high_band[k];
+  }
+
+  self->high_band_gain = target_gain;
+}
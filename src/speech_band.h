@@ -0,0 +1,44 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef SPEECH_BAND_H
+#define SPEECH_BAND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Taps of the halfband filters splitting the signal at a quarter of its rate
+#define SPEECH_BAND_TAPS 31U
+#define SPEECH_BAND_FILTER_DELAY ((SPEECH_BAND_TAPS - 1U) / 2U)
+
+typedef struct SpeechBand SpeechBand;
+
+SpeechBand *speech_band_initialize(uint32_t maximum_block_length,
+                                   uint32_t denoiser_latency);
+void speech_band_free(SpeechBand *self);
+uint32_t speech_band_get_latency(const SpeechBand *self);
+uint32_t speech_band_split(SpeechBand *self, uint32_t number_of_samples,
+                           const float *input);
+const float *speech_band_get_low_band(const SpeechBand *self);
+float *speech_band_get_denoised_low_band(SpeechBand *self);
+void speech_band_merge(SpeechBand *self, uint32_t number_of_samples,
+                       bool residual_listen, float *output);
+
+#endif
@@ -0,0 +1,136 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _GNU_SOURCE
+
+#include "allocation_counter.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+
+// Allocations done while counting is enabled are seen by interposing the
+// allocator of the whole process, and locks by interposing the calls that may
+// block on them. Locks only count on the thread that enabled counting, as
+// helpers wait for work on purpose
+#if defined(__GLIBC__)
+#define COUNTS_ALLOCATIONS 1
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+static atomic_bool counting_allocations;
+static atomic_ulong allocations;
+static _Thread_local bool counting_locks;
+static atomic_ulong locks;
+
+static void count_allocation(void) {
+  if (atomic_load_explicit(&counting_allocations, memory_order_relaxed)) {
+    atomic_fetch_add_explicit(&allocations, 1UL, memory_order_relaxed);
+  }
+}
+
+static void count_lock(void) {
+  if (counting_locks) {
+    atomic_fetch_add_explicit(&locks, 1UL, memory_order_relaxed);
+  }
+}
+
+void *malloc(size_t size) {
+  count_allocation();
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  count_allocation();
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+  count_allocation();
+  return __libc_realloc(pointer, size);
+}
+
+int posix_memalign(void **pointer, size_t alignment, size_t size) {
+  count_allocation();
+  *pointer = __libc_memalign(alignment, size);
+  return *pointer ? 0 : 12;
+}
+
+typedef int (*MutexLockFunction)(pthread_mutex_t *mutex);
+typedef int (*SemaphoreWaitFunction)(sem_t *semaphore);
+
+int pthread_mutex_lock(pthread_mutex_t *mutex) {
+  static _Atomic(MutexLockFunction) next_mutex_lock;
+  MutexLockFunction function = atomic_load(&next_mutex_lock);
+  if (!function) {
+    function = (MutexLockFunction)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    atomic_store(&next_mutex_lock, function);
+  }
+
+  count_lock();
+  return function(mutex);
+}
+
+int sem_wait(sem_t *semaphore) {
+  static _Atomic(SemaphoreWaitFunction) next_sem_wait;
+  SemaphoreWaitFunction function = atomic_load(&next_sem_wait);
+  if (!function) {
+    function = (SemaphoreWaitFunction)dlsym(RTLD_NEXT, "sem_wait");
+    atomic_store(&next_sem_wait, function);
+  }
+
+  count_lock();
+  return function(semaphore);
+}
+#else
+#define COUNTS_ALLOCATIONS 0
+#endif
+
+bool allocation_counter_is_available(void) { return COUNTS_ALLOCATIONS; }
+
+void allocation_counter_set_enabled(const bool enabled) {
+#if COUNTS_ALLOCATIONS
+  atomic_store(&counting_allocations, enabled);
+  counting_locks = enabled;
+#else
+  (void)enabled;
+#endif
+}
+
+unsigned long allocation_counter_get_count(void) {
+#if COUNTS_ALLOCATIONS
+  return atomic_load(&allocations);
+#else
+  return 0UL;
+#endif
+}
+
+unsigned long allocation_counter_get_lock_count(void) {
+#if COUNTS_ALLOCATIONS
+  return atomic_load(&locks);
+#else
+  return 0UL;
+#endif
+}
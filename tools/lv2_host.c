@@ -0,0 +1,634 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _GNU_SOURCE
+
+#include "lv2_host.h"
+#include "lv2/atom/atom.h"
+#include "lv2/buf-size/buf-size.h"
+#include "lv2/log/log.h"
+#include "lv2/options/options.h"
+#include "lv2/state/state.h"
+#include "lv2/urid/urid.h"
+#include "lv2/worker/worker.h"
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CONTROL_PORTS 64U
+#define MAX_URIDS 256U
+#define MAX_WORK_MESSAGES 64U
+#define MAX_WORK_MESSAGE_SIZE 256U
+#define MAX_STATE_PROPERTIES 32U
+#define STATE_FILE_MAGIC "NRPS"
+#define STATE_FILE_VERSION 1U
+
+// clang-format off
+static const PluginLayout layouts[] = {
+    {"https://github.com/lucianodato/noise-repellent#new",
+     18U, 1U, 10U, 0U, 1U, 8U, 6U, 5U, NO_PORT, 9U, 16U, NO_PORT, NO_PORT},
+    {"https://github.com/lucianodato/noise-repellent-stereo#new",
+     21U, 2U, 10U, 0U, 1U, 8U, 6U, 5U, 14U, 9U, 19U, NO_PORT, NO_PORT},
+    {"https://github.com/lucianodato/noise-repellent-stereo#linked",
+     21U, 2U, 10U, 0U, 1U, 8U, 6U, 5U, 14U, 9U, 19U, NO_PORT, NO_PORT},
+    {"https://github.com/lucianodato/noise-repellent-multichannel#4ch",
+     25U, 4U, 15U, 0U, 1U, 8U, 6U, 5U, 10U, 9U, 23U, NO_PORT, NO_PORT},
+    {"https://github.com/lucianodato/noise-repellent-multichannel#6ch",
+     29U, 6U, 15U, 0U, 1U, 8U, 6U, 5U, 10U, 9U, 27U, NO_PORT, NO_PORT},
+    {"https://github.com/lucianodato/noise-repellent-multichannel#8ch",
+     33U, 8U, 15U, 0U, 1U, 8U, 6U, 5U, 10U, 9U, 31U, NO_PORT, NO_PORT},
+    {"https://github.com/lucianodato/noise-repellent-multichannel#12ch",
+     41U, 12U, 15U, 0U, 1U, 8U, 6U, 5U, 10U, 9U, 39U, NO_PORT, NO_PORT},
+    {"https://github.com/lucianodato/noise-repellent-multichannel#16ch",
+     49U, 16U, 15U, 0U, 1U, 8U, 6U, 5U, 10U, 9U, 47U, NO_PORT, NO_PORT},
+    {"https://github.com/lucianodato/noise-repellent#adaptive",
+     14U, 1U, 6U, 0U, 1U, 4U, 3U, NO_PORT, NO_PORT, 5U, 11U, 12U, 13U},
+    {"https://github.com/lucianodato/noise-repellent#adaptive-stereo",
+     17U, 2U, 6U, 0U, 1U, 4U, 3U, NO_PORT, 10U, 5U, 14U, 15U, 16U},
+};
+// clang-format on
+
+typedef struct WorkQueue {
+  uint32_t sizes[MAX_WORK_MESSAGES];
+  uint8_t messages[MAX_WORK_MESSAGES][MAX_WORK_MESSAGE_SIZE];
+  uint32_t count;
+} WorkQueue;
+
+typedef struct StateProperty {
+  char *key;
+  char *type;
+  uint32_t flags;
+  uint32_t size;
+  void *value;
+} StateProperty;
+
+// Properties are kept by uri so they outlive the instance that saved them
+struct Lv2State {
+  char *plugin_uri;
+  StateProperty properties[MAX_STATE_PROPERTIES];
+  uint32_t number_of_properties;
+};
+
+struct Lv2Plugin {
+  const LV2_Descriptor *descriptor;
+  const PluginLayout *layout;
+  LV2_Handle handle;
+  const LV2_Worker_Interface *worker;
+  const LV2_State_Interface *state;
+
+  char *urids[MAX_URIDS];
+  uint32_t number_of_urids;
+  LV2_URID_Map map;
+  LV2_Log_Log log;
+  LV2_Worker_Schedule schedule;
+  int32_t block_length;
+  LV2_Options_Option options[3];
+
+  WorkQueue requests;
+  WorkQueue responses;
+
+  float controls[MAX_CONTROL_PORTS];
+};
+
+void *lv2_library_open(const char *library_path) {
+  void *library = dlopen(library_path, RTLD_NOW | RTLD_LOCAL);
+  if (!library) {
+    fprintf(stderr, "Unable to open <%s>: %s\n", library_path, dlerror());
+  }
+  return library;
+}
+
+void lv2_library_close(void *library) {
+  if (library) {
+    dlclose(library);
+  }
+}
+
+const LV2_Descriptor *lv2_library_get_descriptor(void *library,
+                                                 const uint32_t index) {
+  LV2_Descriptor_Function descriptor_function =
+      (LV2_Descriptor_Function)dlsym(library, "lv2_descriptor");
+  if (!descriptor_function) {
+    return NULL;
+  }
+
+  return descriptor_function(index);
+}
+
+const PluginLayout *plugin_layout_find(const char *uri) {
+  for (size_t i = 0U; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+    if (strcmp(layouts[i].uri, uri) == 0) {
+      return &layouts[i];
+    }
+  }
+  return NULL;
+}
+
+static LV2_URID map_uri(LV2_URID_Map_Handle handle, const char *uri) {
+  Lv2Plugin *self = (Lv2Plugin *)handle;
+
+  for (uint32_t i = 0U; i < self->number_of_urids; i++) {
+    if (strcmp(self->urids[i], uri) == 0) {
+      return i + 1U;
+    }
+  }
+
+  if (self->number_of_urids == MAX_URIDS) {
+    return 0U;
+  }
+
+  self->urids[self->number_of_urids] = strdup(uri);
+  return ++self->number_of_urids;
+}
+
+// Only problems are worth reporting when running outside of a host
+static int log_vprintf(LV2_Log_Handle handle, LV2_URID type, const char *fmt,
+                       va_list args) {
+  Lv2Plugin *self = (Lv2Plugin *)handle;
+  const char *type_uri = type > 0U ? self->urids[type - 1U] : "";
+
+  if (strcmp(type_uri, LV2_LOG__Error) != 0 &&
+      strcmp(type_uri, LV2_LOG__Warning) != 0) {
+    return 0;
+  }
+
+  return vfprintf(stderr, fmt, args);
+}
+
+static int log_printf(LV2_Log_Handle handle, LV2_URID type, const char *fmt,
+                      ...) {
+  va_list args;
+  va_start(args, fmt);
+  const int result = log_vprintf(handle, type, fmt, args);
+  va_end(args);
+  return result;
+}
+
+static LV2_Worker_Status push_message(WorkQueue *queue, const uint32_t size,
+                                      const void *data) {
+  if (queue->count == MAX_WORK_MESSAGES || size > MAX_WORK_MESSAGE_SIZE) {
+    return LV2_WORKER_ERR_NO_SPACE;
+  }
+
+  memcpy(queue->messages[queue->count], data, size);
+  queue->sizes[queue->count] = size;
+  queue->count++;
+
+  return LV2_WORKER_SUCCESS;
+}
+
+static LV2_Worker_Status schedule_work(LV2_Worker_Schedule_Handle handle,
+                                       uint32_t size, const void *data) {
+  Lv2Plugin *self = (Lv2Plugin *)handle;
+  return push_message(&self->requests, size, data);
+}
+
+static LV2_Worker_Status respond(LV2_Worker_Respond_Handle handle,
+                                 uint32_t size, const void *data) {
+  Lv2Plugin *self = (Lv2Plugin *)handle;
+  return push_message(&self->responses, size, data);
+}
+
+Lv2Plugin *lv2_plugin_initialize(const LV2_Descriptor *descriptor,
+                                 const double sample_rate,
+                                 const uint32_t block_length) {
+  const PluginLayout *layout = plugin_layout_find(descriptor->URI);
+  if (!layout) {
+    return NULL;
+  }
+
+  Lv2Plugin *self = (Lv2Plugin *)calloc(1U, sizeof(Lv2Plugin));
+  if (!self) {
+    return NULL;
+  }
+
+  self->descriptor = descriptor;
+  self->layout = layout;
+
+  self->map = (LV2_URID_Map){self, map_uri};
+  self->log = (LV2_Log_Log){self, log_printf, log_vprintf};
+  self->schedule = (LV2_Worker_Schedule){self, schedule_work};
+
+  // Blocks are always run at the same length
+  self->block_length = (int32_t)block_length;
+  const LV2_URID atom_int = map_uri(self, LV2_ATOM__Int);
+  self->options[0] = (LV2_Options_Option){
+      LV2_OPTIONS_INSTANCE, 0U, map_uri(self, LV2_BUF_SIZE__maxBlockLength),
+      sizeof(int32_t), atom_int, &self->block_length};
+  self->options[1] = (LV2_Options_Option){
+      LV2_OPTIONS_INSTANCE, 0U,
+      map_uri(self, LV2_BUF_SIZE__nominalBlockLength), sizeof(int32_t),
+      atom_int, &self->block_length};
+
+  if (descriptor->extension_data) {
+    self->worker = (const LV2_Worker_Interface *)descriptor->extension_data(
+        LV2_WORKER__interface);
+    self->state = (const LV2_State_Interface *)descriptor->extension_data(
+        LV2_STATE__interface);
+  }
+
+  const LV2_Feature map_feature = {LV2_URID__map, &self->map};
+  const LV2_Feature log_feature = {LV2_LOG__log, &self->log};
+  const LV2_Feature options_feature = {LV2_OPTIONS__options, self->options};
+  const LV2_Feature schedule_feature = {LV2_WORKER__schedule, &self->schedule};
+  const LV2_Feature *features[] = {&map_feature, &log_feature, &options_feature,
+                                   self->worker ? &schedule_feature : NULL,
+                                   NULL};
+
+  self->handle = descriptor->instantiate(descriptor, sample_rate, "", features);
+  if (!self->handle) {
+    lv2_plugin_free(self);
+    return NULL;
+  }
+
+  for (uint32_t port = 0U; port < layout->number_of_ports; port++) {
+    descriptor->connect_port(self->handle, port, &self->controls[port]);
+  }
+
+  self->controls[layout->reduction_port] = 10.F;
+  self->controls[layout->offset_port] = 2.F;
+  self->controls[layout->enable_port] = 1.F;
+
+  return self;
+}
+
+void lv2_plugin_free(Lv2Plugin *self) {
+  if (self->handle) {
+    self->descriptor->cleanup(self->handle);
+  }
+
+  for (uint32_t i = 0U; i < self->number_of_urids; i++) {
+    free(self->urids[i]);
+  }
+
+  free(self);
+}
+
+const PluginLayout *lv2_plugin_get_layout(const Lv2Plugin *self) {
+  return self->layout;
+}
+
+void lv2_plugin_set_control(Lv2Plugin *self, const uint32_t port,
+                            const float value) {
+  if (port < MAX_CONTROL_PORTS) {
+    self->controls[port] = value;
+  }
+}
+
+float lv2_plugin_get_control(const Lv2Plugin *self, const uint32_t port) {
+  return port < MAX_CONTROL_PORTS ? self->controls[port] : 0.F;
+}
+
+void lv2_plugin_connect_audio(Lv2Plugin *self, const float *const *inputs,
+                              float *const *outputs) {
+  // Every variant places the input and output of a channel next to each other
+  for (uint32_t i = 0U; i < self->layout->number_of_channels; i++) {
+    const uint32_t port = self->layout->audio_ports_start + 2U * i;
+    self->descriptor->connect_port(self->handle, port, (void *)inputs[i]);
+    self->descriptor->connect_port(self->handle, port + 1U, outputs[i]);
+  }
+}
+
+void lv2_plugin_activate(Lv2Plugin *self) {
+  if (self->descriptor->activate) {
+    self->descriptor->activate(self->handle);
+  }
+}
+
+void lv2_plugin_run(Lv2Plugin *self, const uint32_t number_of_samples) {
+  self->descriptor->run(self->handle, number_of_samples);
+}
+
+// Work is done synchronously between cycles, like a host would do it from its
+// worker thread
+void lv2_plugin_run_worker(Lv2Plugin *self) {
+  if (!self->worker) {
+    return;
+  }
+
+  for (uint32_t i = 0U; i < self->requests.count; i++) {
+    self->worker->work(self->handle, respond, self, self->requests.sizes[i],
+                       self->requests.messages[i]);
+  }
+  self->requests.count = 0U;
+
+  for (uint32_t i = 0U; i < self->responses.count; i++) {
+    self->worker->work_response(self->handle, self->responses.sizes[i],
+                                self->responses.messages[i]);
+  }
+  self->responses.count = 0U;
+
+  if (self->worker->end_run) {
+    self->worker->end_run(self->handle);
+  }
+}
+
+static const char *unmap_uri(const Lv2Plugin *self, const LV2_URID urid) {
+  if (urid == 0U || urid > self->number_of_urids) {
+    return NULL;
+  }
+  return self->urids[urid - 1U];
+}
+
+static LV2_State_Status store_property(LV2_State_Handle handle, uint32_t key,
+                                       const void *value, size_t size,
+                                       uint32_t type, uint32_t flags) {
+  void **handles = (void **)handle;
+  const Lv2Plugin *plugin = (const Lv2Plugin *)handles[0];
+  Lv2State *state = (Lv2State *)handles[1];
+
+  const char *key_uri = unmap_uri(plugin, key);
+  const char *type_uri = unmap_uri(plugin, type);
+  if (!key_uri || !type_uri) {
+    return LV2_STATE_ERR_UNKNOWN;
+  }
+  if (state->number_of_properties == MAX_STATE_PROPERTIES) {
+    return LV2_STATE_ERR_NO_SPACE;
+  }
+
+  StateProperty *property = &state->properties[state->number_of_properties];
+  property->key = strdup(key_uri);
+  property->type = strdup(type_uri);
+  property->value = malloc(size);
+  if (!property->key || !property->type || !property->value) {
+    free(property->key);
+    free(property->type);
+    free(property->value);
+    memset(property, 0, sizeof(StateProperty));
+    return LV2_STATE_ERR_NO_SPACE;
+  }
+
+  memcpy(property->value, value, size);
+  property->size = (uint32_t)size;
+  property->flags = flags;
+  state->number_of_properties++;
+
+  return LV2_STATE_SUCCESS;
+}
+
+static const void *retrieve_property(LV2_State_Handle handle, uint32_t key,
+                                     size_t *size, uint32_t *type,
+                                     uint32_t *flags) {
+  void **handles = (void **)handle;
+  Lv2Plugin *plugin = (Lv2Plugin *)handles[0];
+  const Lv2State *state = (const Lv2State *)handles[1];
+
+  const char *key_uri = unmap_uri(plugin, key);
+  if (!key_uri) {
+    return NULL;
+  }
+
+  for (uint32_t i = 0U; i < state->number_of_properties; i++) {
+    const StateProperty *property = &state->properties[i];
+    if (strcmp(property->key, key_uri) == 0) {
+      *size = property->size;
+      *type = map_uri(plugin, property->type);
+      *flags = property->flags;
+      return property->value;
+    }
+  }
+
+  return NULL;
+}
+
+Lv2State *lv2_plugin_save_state(Lv2Plugin *self) {
+  if (!self->state) {
+    return NULL;
+  }
+
+  Lv2State *state = (Lv2State *)calloc(1U, sizeof(Lv2State));
+  if (!state) {
+    return NULL;
+  }
+
+  state->plugin_uri = strdup(self->descriptor->URI);
+  void *handles[] = {self, state};
+
+  if (!state->plugin_uri ||
+      self->state->save(self->handle, store_property, handles,
+                        LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE,
+                        NULL) != LV2_STATE_SUCCESS ||
+      state->number_of_properties == 0U) {
+    lv2_state_free(state);
+    return NULL;
+  }
+
+  return state;
+}
+
+bool lv2_plugin_restore_state(Lv2Plugin *self, const Lv2State *state) {
+  if (!self->state || strcmp(state->plugin_uri, self->descriptor->URI) != 0) {
+    return false;
+  }
+
+  const LV2_Feature schedule_feature = {LV2_WORKER__schedule, &self->schedule};
+  const LV2_Feature *features[] = {self->worker ? &schedule_feature : NULL,
+                                   NULL};
+  void *handles[] = {self, (void *)state};
+
+  if (self->state->restore(self->handle, retrieve_property, handles, 0U,
+                           features) != LV2_STATE_SUCCESS) {
+    return false;
+  }
+
+  // Profiles prepared by the worker are applied right away
+  lv2_plugin_run_worker(self);
+
+  return true;
+}
+
+void lv2_state_free(Lv2State *self) {
+  if (!self) {
+    return;
+  }
+
+  for (uint32_t i = 0U; i < self->number_of_properties; i++) {
+    free(self->properties[i].key);
+    free(self->properties[i].type);
+    free(self->properties[i].value);
+  }
+
+  free(self->plugin_uri);
+  free(self);
+}
+
+const char *lv2_state_get_plugin_uri(const Lv2State *self) {
+  return self->plugin_uri;
+}
+
+// Keys are matched by how they end, the part following the plugin uri
+static StateProperty *find_property(const Lv2State *self, const char *suffix) {
+  const size_t suffix_length = strlen(suffix);
+  for (uint32_t i = 0U; i < self->number_of_properties; i++) {
+    const StateProperty *property = &self->properties[i];
+    const size_t key_length = strlen(property->key);
+    if (key_length >= suffix_length &&
+        strcmp(&property->key[key_length - suffix_length], suffix) == 0) {
+      return (StateProperty *)property;
+    }
+  }
+  return NULL;
+}
+
+const void *lv2_state_get_value(const Lv2State *self, const char *key_suffix,
+                                uint32_t *size) {
+  const StateProperty *property = find_property(self, key_suffix);
+  if (!property) {
+    return NULL;
+  }
+  *size = property->size;
+  return property->value;
+}
+
+// Leaves the state as older plugins that never stored the key saved it
+bool lv2_state_remove_value(Lv2State *self, const char *key_suffix) {
+  StateProperty *property = find_property(self, key_suffix);
+  if (!property) {
+    return false;
+  }
+
+  free(property->key);
+  free(property->type);
+  free(property->value);
+
+  const size_t following =
+      (size_t)(&self->properties[self->number_of_properties] - property) - 1U;
+  memmove(property, property + 1, sizeof(StateProperty) * following);
+  self->number_of_properties--;
+
+  return true;
+}
+
+// Properties are compared in the order the plugin stored them
+bool lv2_state_equal(const Lv2State *self, const Lv2State *other) {
+  if (strcmp(self->plugin_uri, other->plugin_uri) != 0 ||
+      self->number_of_properties != other->number_of_properties) {
+    return false;
+  }
+
+  for (uint32_t i = 0U; i < self->number_of_properties; i++) {
+    const StateProperty *property = &self->properties[i];
+    const StateProperty *other_property = &other->properties[i];
+    if (strcmp(property->key, other_property->key) != 0 ||
+        strcmp(property->type, other_property->type) != 0 ||
+        property->size != other_property->size ||
+        memcmp(property->value, other_property->value, property->size) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool write_string(FILE *file, const char *string) {
+  const uint32_t length = (uint32_t)strlen(string);
+  return fwrite(&length, sizeof(uint32_t), 1U, file) == 1U &&
+         fwrite(string, 1U, length, file) == length;
+}
+
+static char *read_string(FILE *file) {
+  uint32_t length = 0U;
+  if (fread(&length, sizeof(uint32_t), 1U, file) != 1U || length > 4096U) {
+    return NULL;
+  }
+
+  char *string = (char *)calloc(length + 1U, sizeof(char));
+  if (string && fread(string, 1U, length, file) != length) {
+    free(string);
+    return NULL;
+  }
+
+  return string;
+}
+
+// Values are written as the plugin stored them, so the noise profile keeps the
+// layout of its saved state. Files are meant for machines of the same
+// endianness
+bool lv2_state_write(const Lv2State *self, const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+
+  const uint32_t header[] = {STATE_FILE_VERSION, self->number_of_properties};
+  bool success = fwrite(STATE_FILE_MAGIC, 1U, 4U, file) == 4U &&
+                 fwrite(header, sizeof(header), 1U, file) == 1U &&
+                 write_string(file, self->plugin_uri);
+
+  for (uint32_t i = 0U; success && i < self->number_of_properties; i++) {
+    const StateProperty *property = &self->properties[i];
+    const uint32_t value_header[] = {property->flags, property->size};
+    success = write_string(file, property->key) &&
+              write_string(file, property->type) &&
+              fwrite(value_header, sizeof(value_header), 1U, file) == 1U &&
+              fwrite(property->value, 1U, property->size, file) ==
+                  property->size;
+  }
+
+  return fclose(file) == 0 && success;
+}
+
+Lv2State *lv2_state_read(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return NULL;
+  }
+
+  Lv2State *self = (Lv2State *)calloc(1U, sizeof(Lv2State));
+  char magic[4];
+  uint32_t header[2] = {0U, 0U};
+
+  bool success =
+      self && fread(magic, 1U, 4U, file) == 4U &&
+      memcmp(magic, STATE_FILE_MAGIC, 4U) == 0 &&
+      fread(header, sizeof(header), 1U, file) == 1U &&
+      header[0] == STATE_FILE_VERSION && header[1] <= MAX_STATE_PROPERTIES &&
+      (self->plugin_uri = read_string(file)) != NULL;
+
+  for (uint32_t i = 0U; success && i < header[1]; i++) {
+    StateProperty *property = &self->properties[i];
+    uint32_t value_header[2];
+
+    property->key = read_string(file);
+    property->type = read_string(file);
+    success = property->key && property->type &&
+              fread(value_header, sizeof(value_header), 1U, file) == 1U;
+    self->number_of_properties++;
+
+    if (success) {
+      property->flags = value_header[0];
+      property->size = value_header[1];
+      property->value = malloc(property->size);
+      success = property->value && fread(property->value, 1U, property->size,
+                                         file) == property->size;
+    }
+  }
+
+  fclose(file);
+
+  if (!success) {
+    lv2_state_free(self);
+    return NULL;
+  }
+
+  return self;
+}
@@ -0,0 +1,80 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef LV2_HOST_H
+#define LV2_HOST_H
+
+#include "lv2/core/lv2.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NO_PORT UINT32_MAX
+#define MAX_CHANNELS 16U
+
+typedef struct PluginLayout {
+  const char *uri;
+  uint32_t number_of_ports;
+  uint32_t number_of_channels;
+  uint32_t audio_ports_start;
+  uint32_t reduction_port;
+  uint32_t offset_port;
+  uint32_t enable_port;
+  uint32_t residual_listen_port;
+  uint32_t learn_port;
+  uint32_t parallel_port;
+  uint32_t latency_port;
+  uint32_t free_wheeling_port;
+  uint32_t speech_band_port;
+  uint32_t warm_start_port;
+} PluginLayout;
+
+typedef struct Lv2Plugin Lv2Plugin;
+typedef struct Lv2State Lv2State;
+
+const LV2_Descriptor *lv2_library_get_descriptor(void *library,
+                                                 uint32_t index);
+void *lv2_library_open(const char *library_path);
+void lv2_library_close(void *library);
+const PluginLayout *plugin_layout_find(const char *uri);
+
+Lv2Plugin *lv2_plugin_initialize(const LV2_Descriptor *descriptor,
+                                 double sample_rate, uint32_t block_length);
+void lv2_plugin_free(Lv2Plugin *self);
+const PluginLayout *lv2_plugin_get_layout(const Lv2Plugin *self);
+void lv2_plugin_set_control(Lv2Plugin *self, uint32_t port, float value);
+float lv2_plugin_get_control(const Lv2Plugin *self, uint32_t port);
+void lv2_plugin_connect_audio(Lv2Plugin *self, const float *const *inputs,
+                              float *const *outputs);
+void lv2_plugin_activate(Lv2Plugin *self);
+void lv2_plugin_run(Lv2Plugin *self, uint32_t number_of_samples);
+void lv2_plugin_run_worker(Lv2Plugin *self);
+Lv2State *lv2_plugin_save_state(Lv2Plugin *self);
+bool lv2_plugin_restore_state(Lv2Plugin *self, const Lv2State *state);
+
+Lv2State *lv2_state_read(const char *path);
+bool lv2_state_write(const Lv2State *self, const char *path);
+void lv2_state_free(Lv2State *self);
+bool lv2_state_equal(const Lv2State *self, const Lv2State *other);
+const char *lv2_state_get_plugin_uri(const Lv2State *self);
+const void *lv2_state_get_value(const Lv2State *self, const char *key_suffix,
+                                uint32_t *size);
+bool lv2_state_remove_value(Lv2State *self, const char *key_suffix);
+
+#endif
@@ -0,0 +1,579 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _GNU_SOURCE
+
+#include "lv2_host.h"
+#include "wav_file.h"
+#include <dirent.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef NREPELLENT_BUNDLE_DIR
+#define NREPELLENT_BUNDLE_DIR "."
+#endif
+
+#ifndef NREPELLENT_LIB_EXT
+#define NREPELLENT_LIB_EXT ".so"
+#endif
+
+#define NOISEREPELLENT_URI "https://github.com/lucianodato/noise-repellent#new"
+#define NOISEREPELLENT_STEREO_URI                                              \
+  "https://github.com/lucianodato/noise-repellent-stereo#new"
+#define NOISEREPELLENT_MULTICHANNEL_URI                                        \
+  "https://github.com/lucianodato/noise-repellent-multichannel"
+#define NOISEREPELLENT_ADAPTIVE_URI                                            \
+  "https://github.com/lucianodato/noise-repellent#adaptive"
+#define NOISEREPELLENT_ADAPTIVE_STEREO_URI                                     \
+  "https://github.com/lucianodato/noise-repellent#adaptive-stereo"
+
+#define BLOCK_SIZE 8192U
+#define MAX_PATH_SIZE 4096U
+
+typedef struct BatchOptions {
+  const char *bundle_directory;
+  const char *profile_path;
+  const char *noise_path;
+  bool adaptive;
+  uint32_t number_of_jobs;
+  float reduction;
+  float offset;
+} BatchOptions;
+
+typedef struct Engine {
+  const BatchOptions *options;
+  void *libraries[2];
+  const Lv2State *profile;
+  float *inputs[MAX_CHANNELS];
+  float *outputs[MAX_CHANNELS];
+} Engine;
+
+typedef struct FileList {
+  char **paths;
+  uint32_t number_of_paths;
+  uint32_t capacity;
+} FileList;
+
+static bool engine_initialize(Engine *self, const BatchOptions *options,
+                              const Lv2State *profile) {
+  memset(self, 0, sizeof(Engine));
+  self->options = options;
+  self->profile = profile;
+
+  static const char *library_names[] = {"nrepellent", "nrepellent-adaptive"};
+  for (uint32_t i = 0U; i < 2U; i++) {
+    char path[MAX_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s/%s%s", options->bundle_directory,
+             library_names[i], NREPELLENT_LIB_EXT);
+    self->libraries[i] = lv2_library_open(path);
+    if (!self->libraries[i]) {
+      return false;
+    }
+  }
+
+  for (uint32_t channel = 0U; channel < MAX_CHANNELS; channel++) {
+    self->inputs[channel] = (float *)calloc(BLOCK_SIZE, sizeof(float));
+    self->outputs[channel] = (float *)calloc(BLOCK_SIZE, sizeof(float));
+    if (!self->inputs[channel] || !self->outputs[channel]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void engine_free(Engine *self) {
+  for (uint32_t i = 0U; i < 2U; i++) {
+    lv2_library_close(self->libraries[i]);
+  }
+  for (uint32_t channel = 0U; channel < MAX_CHANNELS; channel++) {
+    free(self->inputs[channel]);
+    free(self->outputs[channel]);
+  }
+}
+
+static const LV2_Descriptor *engine_find_descriptor(const Engine *self,
+                                                    const char *uri) {
+  for (uint32_t i = 0U; i < 2U; i++) {
+    const LV2_Descriptor *descriptor = NULL;
+    for (uint32_t index = 0U;
+         (descriptor = lv2_library_get_descriptor(self->libraries[i], index));
+         index++) {
+      if (strcmp(descriptor->URI, uri) == 0) {
+        return descriptor;
+      }
+    }
+  }
+  return NULL;
+}
+
+static const char *select_plugin_uri(const Engine *self,
+                                     const uint32_t number_of_channels) {
+  // There are no multichannel variants of the adaptive denoiser
+  if (self->options->adaptive) {
+    if (number_of_channels > 2U) {
+      return NULL;
+    }
+    return number_of_channels == 1U ? NOISEREPELLENT_ADAPTIVE_URI
+                                    : NOISEREPELLENT_ADAPTIVE_STEREO_URI;
+  }
+
+  // A saved profile only fits the variant that learned it
+  if (self->profile) {
+    return lv2_state_get_plugin_uri(self->profile);
+  }
+
+  if (number_of_channels <= 2U) {
+    return number_of_channels == 1U ? NOISEREPELLENT_URI
+                                    : NOISEREPELLENT_STEREO_URI;
+  }
+
+  static const char *multichannel_uris[] = {
+      NOISEREPELLENT_MULTICHANNEL_URI "#4ch",
+      NOISEREPELLENT_MULTICHANNEL_URI "#6ch",
+      NOISEREPELLENT_MULTICHANNEL_URI "#8ch",
+      NOISEREPELLENT_MULTICHANNEL_URI "#12ch",
+      NOISEREPELLENT_MULTICHANNEL_URI "#16ch",
+  };
+  for (size_t i = 0U; i < sizeof(multichannel_uris) / sizeof(char *); i++) {
+    if (plugin_layout_find(multichannel_uris[i])->number_of_channels ==
+        number_of_channels) {
+      return multichannel_uris[i];
+    }
+  }
+
+  return NULL;
+}
+
+static Lv2Plugin *engine_instantiate(Engine *self, const WavInfo *info,
+                                     const char *path) {
+  const char *uri = select_plugin_uri(self, info->number_of_channels);
+  if (!uri) {
+    fprintf(stderr, "%s: no variant processes %u channels\n", path,
+            (unsigned int)info->number_of_channels);
+    return NULL;
+  }
+
+  const LV2_Descriptor *descriptor = engine_find_descriptor(self, uri);
+  if (!descriptor) {
+    fprintf(stderr, "%s: plugin <%s> not found\n", path, uri);
+    return NULL;
+  }
+
+  Lv2Plugin *plugin =
+      lv2_plugin_initialize(descriptor, info->sample_rate, BLOCK_SIZE);
+  if (!plugin) {
+    fprintf(stderr, "%s: unable to instantiate <%s>\n", path, uri);
+    return NULL;
+  }
+
+  const PluginLayout *layout = lv2_plugin_get_layout(plugin);
+  if (layout->number_of_channels != info->number_of_channels) {
+    fprintf(stderr,
+            "%s: the noise profile was learned with a %u channel file\n", path,
+            (unsigned int)layout->number_of_channels);
+    lv2_plugin_free(plugin);
+    return NULL;
+  }
+
+  lv2_plugin_set_control(plugin, layout->reduction_port,
+                         self->options->reduction);
+  lv2_plugin_set_control(plugin, layout->offset_port, self->options->offset);
+  lv2_plugin_set_control(plugin, layout->free_wheeling_port, 1.F);
+  lv2_plugin_connect_audio(plugin, (const float *const *)self->inputs,
+                           self->outputs);
+  lv2_plugin_activate(plugin);
+
+  if (self->profile && !lv2_plugin_restore_state(plugin, self->profile)) {
+    fprintf(stderr, "%s: the noise profile doesn't fit this sample rate\n",
+            path);
+    lv2_plugin_free(plugin);
+    return NULL;
+  }
+
+  return plugin;
+}
+
+// Output is shifted back by the reported latency so it lines up with the input
+static bool stream_file(Engine *self, Lv2Plugin *plugin, WavReader *reader,
+                        WavWriter *writer) {
+  const WavInfo *info = wav_reader_get_info(reader);
+  const PluginLayout *layout = lv2_plugin_get_layout(plugin);
+
+  uint64_t remaining_frames = info->number_of_frames;
+  uint64_t latency_frames = 0U;
+  bool latency_known = false;
+
+  while (remaining_frames > 0U) {
+    const uint32_t frames_read =
+        wav_reader_read(reader, self->inputs, BLOCK_SIZE);
+    for (uint32_t channel = 0U; channel < info->number_of_channels;
+         channel++) {
+      memset(&self->inputs[channel][frames_read], 0,
+             sizeof(float) * (BLOCK_SIZE - frames_read));
+    }
+
+    lv2_plugin_run(plugin, BLOCK_SIZE);
+    lv2_plugin_run_worker(plugin);
+
+    if (!latency_known) {
+      latency_frames =
+          (uint64_t)lv2_plugin_get_control(plugin, layout->latency_port);
+      latency_known = true;
+    }
+
+    uint32_t start = BLOCK_SIZE;
+    if (latency_frames < BLOCK_SIZE) {
+      start = (uint32_t)latency_frames;
+    }
+    latency_frames -= start;
+
+    uint32_t frames = BLOCK_SIZE - start;
+    if (frames > remaining_frames) {
+      frames = (uint32_t)remaining_frames;
+    }
+    remaining_frames -= frames;
+
+    if (writer && frames > 0U) {
+      const float *block[MAX_CHANNELS] = {NULL};
+      for (uint32_t channel = 0U; channel < info->number_of_channels;
+           channel++) {
+        block[channel] = &self->outputs[channel][start];
+      }
+      if (!wav_writer_write(writer, block, frames)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+static bool process_file(Engine *self, const char *input_path,
+                         const char *output_path) {
+  WavReader *reader = wav_reader_open(input_path);
+  if (!reader) {
+    fprintf(stderr, "%s: not a supported wav file\n", input_path);
+    return false;
+  }
+
+  const WavInfo *info = wav_reader_get_info(reader);
+  Lv2Plugin *plugin = engine_instantiate(self, info, input_path);
+  if (!plugin) {
+    wav_reader_close(reader);
+    return false;
+  }
+
+  WavWriter *writer = wav_writer_open(output_path, info);
+  bool success = writer && stream_file(self, plugin, reader, writer);
+  if (writer) {
+    success = wav_writer_close(writer) && success;
+  }
+  if (!success) {
+    fprintf(stderr, "%s: unable to write the output\n", output_path);
+  }
+
+  lv2_plugin_free(plugin);
+  wav_reader_close(reader);
+
+  return success;
+}
+
+static bool learn_profile(Engine *self, const char *noise_path,
+                          const char *profile_path) {
+  WavReader *reader = wav_reader_open(noise_path);
+  if (!reader) {
+    fprintf(stderr, "%s: not a supported wav file\n", noise_path);
+    return false;
+  }
+
+  Lv2Plugin *plugin =
+      engine_instantiate(self, wav_reader_get_info(reader), noise_path);
+  if (!plugin) {
+    wav_reader_close(reader);
+    return false;
+  }
+
+  lv2_plugin_set_control(plugin, lv2_plugin_get_layout(plugin)->learn_port,
+                         1.F);
+  stream_file(self, plugin, reader, NULL);
+
+  Lv2State *profile = lv2_plugin_save_state(plugin);
+  const bool success = profile && lv2_state_write(profile, profile_path);
+  if (!success) {
+    fprintf(stderr, "%s: unable to store the noise profile\n", profile_path);
+  }
+
+  lv2_state_free(profile);
+  lv2_plugin_free(plugin);
+  wav_reader_close(reader);
+
+  return success;
+}
+
+static bool has_wav_extension(const char *name) {
+  const size_t length = strlen(name);
+  return length > 4U && strcasecmp(&name[length - 4U], ".wav") == 0;
+}
+
+static bool file_list_add(FileList *self, const char *path) {
+  if (self->number_of_paths == self->capacity) {
+    const uint32_t capacity = self->capacity ? self->capacity * 2U : 64U;
+    char **paths = (char **)realloc(self->paths, capacity * sizeof(char *));
+    if (!paths) {
+      return false;
+    }
+    self->paths = paths;
+    self->capacity = capacity;
+  }
+
+  self->paths[self->number_of_paths] = strdup(path);
+  return self->paths[self->number_of_paths++] != NULL;
+}
+
+static int compare_paths(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static bool file_list_collect(FileList *self, const char *path) {
+  struct stat status;
+  if (stat(path, &status) != 0) {
+    fprintf(stderr, "%s: no such file or directory\n", path);
+    return false;
+  }
+
+  if (!S_ISDIR(status.st_mode)) {
+    return file_list_add(self, path);
+  }
+
+  DIR *directory = opendir(path);
+  if (!directory) {
+    return false;
+  }
+
+  const struct dirent *entry = NULL;
+  while ((entry = readdir(directory))) {
+    if (entry->d_name[0] == '.' || !has_wav_extension(entry->d_name)) {
+      continue;
+    }
+
+    char entry_path[MAX_PATH_SIZE];
+    snprintf(entry_path, sizeof(entry_path), "%s/%s", path, entry->d_name);
+    if (!file_list_add(self, entry_path)) {
+      closedir(directory);
+      return false;
+    }
+  }
+  closedir(directory);
+
+  // Sorted so every run hands out files in the same order
+  qsort(self->paths, self->number_of_paths, sizeof(char *), compare_paths);
+
+  return true;
+}
+
+static void file_list_free(FileList *self) {
+  for (uint32_t i = 0U; i < self->number_of_paths; i++) {
+    free(self->paths[i]);
+  }
+  free(self->paths);
+}
+
+// Every job claims the next pending file from a counter shared across
+// processes, so long and short recordings even out between them
+static uint32_t run_job(Engine *engine, const FileList *files,
+                        const char *output_directory, atomic_uint *next_file) {
+  uint32_t failures = 0U;
+
+  for (uint32_t index = atomic_fetch_add(next_file, 1U);
+       index < files->number_of_paths;
+       index = atomic_fetch_add(next_file, 1U)) {
+    const char *input_path = files->paths[index];
+    const char *name = strrchr(input_path, '/');
+    name = name ? name + 1 : input_path;
+
+    char output_path[MAX_PATH_SIZE];
+    snprintf(output_path, sizeof(output_path), "%s/%s", output_directory,
+             name);
+
+    if (!process_file(engine, input_path, output_path)) {
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+static bool run_jobs(const BatchOptions *options, const Lv2State *profile,
+                     const FileList *files, const char *output_directory) {
+  atomic_uint *next_file =
+      (atomic_uint *)mmap(NULL, sizeof(atomic_uint), PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (next_file == MAP_FAILED) {
+    return false;
+  }
+  atomic_init(next_file, 0U);
+
+  uint32_t number_of_jobs = options->number_of_jobs;
+  if (number_of_jobs > files->number_of_paths) {
+    number_of_jobs = files->number_of_paths;
+  }
+
+  bool success = true;
+  uint32_t started_jobs = 0U;
+
+  for (uint32_t job = 0U; job < number_of_jobs; job++) {
+    const pid_t pid = fork();
+    if (pid < 0) {
+      success = false;
+      break;
+    }
+
+    if (pid == 0) {
+      Engine engine;
+      uint32_t failures = files->number_of_paths;
+      if (engine_initialize(&engine, options, profile)) {
+        failures = run_job(&engine, files, output_directory, next_file);
+      }
+      engine_free(&engine);
+      _exit(failures == 0U ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    started_jobs++;
+  }
+
+  for (uint32_t job = 0U; job < started_jobs; job++) {
+    int status = 0;
+    if (wait(&status) < 0 || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != EXIT_SUCCESS) {
+      success = false;
+    }
+  }
+
+  munmap(next_file, sizeof(atomic_uint));
+
+  return success;
+}
+
+static void print_usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options] -l noise.wav -p profile\n"
+          "       %s [options] -p profile input... output-directory\n"
+          "       %s [options] -a input... output-directory\n"
+          "\n"
+          "  -l file   learn a noise profile from file and store it in -p\n"
+          "  -p file   noise profile to apply\n"
+          "  -a        use the adaptive noise estimation instead of a profile\n"
+          "  -r dB     amount of reduction (default 10)\n"
+          "  -o dB     noise offset (default 2)\n"
+          "  -j jobs   files processed at the same time (default: cpus)\n"
+          "  -b dir    directory of the plugin bundle (default %s)\n",
+          program, program, program, NREPELLENT_BUNDLE_DIR);
+}
+
+int main(int argc, char **argv) {
+  const long number_of_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  BatchOptions options = {
+      .bundle_directory = NREPELLENT_BUNDLE_DIR,
+      .number_of_jobs = number_of_cpus > 0 ? (uint32_t)number_of_cpus : 1U,
+      .reduction = 10.F,
+      .offset = 2.F,
+  };
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "l:p:ar:o:j:b:h")) != -1) {
+    switch (option) {
+    case 'l':
+      options.noise_path = optarg;
+      break;
+    case 'p':
+      options.profile_path = optarg;
+      break;
+    case 'a':
+      options.adaptive = true;
+      break;
+    case 'r':
+      options.reduction = strtof(optarg, NULL);
+      break;
+    case 'o':
+      options.offset = strtof(optarg, NULL);
+      break;
+    case 'j':
+      options.number_of_jobs = (uint32_t)strtoul(optarg, NULL, 10);
+      break;
+    case 'b':
+      options.bundle_directory = optarg;
+      break;
+    default:
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (options.noise_path) {
+    if (!options.profile_path || options.adaptive || optind != argc) {
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+
+    Engine engine;
+    const bool success = engine_initialize(&engine, &options, NULL) &&
+                         learn_profile(&engine, options.noise_path,
+                                       options.profile_path);
+    engine_free(&engine);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if (argc - optind < 2 || options.number_of_jobs == 0U ||
+      options.adaptive == (options.profile_path != NULL)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  Lv2State *profile = NULL;
+  if (options.profile_path) {
+    profile = lv2_state_read(options.profile_path);
+    if (!profile) {
+      fprintf(stderr, "%s: not a noise profile\n", options.profile_path);
+      return EXIT_FAILURE;
+    }
+  }
+
+  FileList files = {NULL, 0U, 0U};
+  bool success = true;
+  for (int i = optind; success && i < argc - 1; i++) {
+    success = file_list_collect(&files, argv[i]);
+  }
+
+  success = success && run_jobs(&options, profile, &files, argv[argc - 1]);
+
+  file_list_free(&files);
+  lv2_state_free(profile);
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
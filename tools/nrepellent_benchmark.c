@@ -0,0 +1,291 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _GNU_SOURCE
+
+#include "allocation_counter.h"
+#include "lv2_host.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.1415926535F
+#endif
+
+#define MIN_BLOCK_SIZE 16U
+#define MAX_BLOCK_SIZE 8192U
+#define PREROLL_SECONDS 0.5F
+#define DEFAULT_SECONDS 2.F
+
+typedef struct BenchmarkSetting {
+  const char *name;
+  float enable;
+  float residual_listen;
+  float learn;
+  float parallel;
+  bool in_place;
+} BenchmarkSetting;
+
+static const uint32_t sample_rates[] = {44100U, 48000U, 96000U};
+
+// clang-format off
+static const BenchmarkSetting settings[] = {
+    {"denoise", 1.F, 0.F, 0.F, 0.F, false},
+    {"residual", 1.F, 1.F, 0.F, 0.F, false},
+    {"bypassed", 0.F, 0.F, 0.F, 0.F, false},
+    {"learn", 1.F, 0.F, 1.F, 0.F, false},
+    {"parallel", 1.F, 0.F, 0.F, 1.F, false},
+    {"in-place", 1.F, 0.F, 0.F, 0.F, true},
+};
+// clang-format on
+
+typedef struct BenchmarkResult {
+  double nanoseconds_per_sample;
+  double worst_cycle_microseconds;
+  double allocations_per_cycle;
+} BenchmarkResult;
+
+static uint64_t get_time_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// One second of a tone over white noise, looped as the benchmark input
+static float *generate_signal(const uint32_t sample_rate) {
+  float *signal = (float *)calloc(sample_rate, sizeof(float));
+  if (!signal) {
+    return NULL;
+  }
+
+  uint32_t seed = 1U;
+  for (uint32_t k = 0U; k < sample_rate; k++) {
+    seed = seed * 1664525U + 1013904223U;
+    const float noise = ((float)(seed >> 8U) / 8388608.F) - 1.F;
+    signal[k] = 0.05F * noise +
+                0.3F * sinf(2.F * M_PI * 440.F * (float)k / (float)sample_rate);
+  }
+
+  return signal;
+}
+
+static bool setting_applies(const BenchmarkSetting *setting,
+                            const PluginLayout *layout) {
+  if (setting->learn > 0.F && layout->learn_port == NO_PORT) {
+    return false;
+  }
+  if (setting->parallel > 0.F && layout->parallel_port == NO_PORT) {
+    return false;
+  }
+  return true;
+}
+
+static void set_control(Lv2Plugin *plugin, const uint32_t port,
+                        const float value) {
+  if (port != NO_PORT) {
+    lv2_plugin_set_control(plugin, port, value);
+  }
+}
+
+static void fill_inputs(const float *signal, const uint32_t sample_rate,
+                        uint64_t *position, float **inputs,
+                        const uint32_t number_of_channels,
+                        const uint32_t block_size) {
+  for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+    for (uint32_t k = 0U; k < block_size; k++) {
+      inputs[channel][k] = signal[(*position + k) % sample_rate];
+    }
+  }
+  *position += block_size;
+}
+
+static bool run_benchmark(const LV2_Descriptor *descriptor,
+                          const uint32_t sample_rate,
+                          const uint32_t block_size,
+                          const BenchmarkSetting *setting, const float seconds,
+                          const float *signal, BenchmarkResult *result) {
+  Lv2Plugin *plugin =
+      lv2_plugin_initialize(descriptor, (double)sample_rate, block_size);
+  if (!plugin) {
+    return false;
+  }
+
+  const PluginLayout *layout = lv2_plugin_get_layout(plugin);
+  const uint32_t number_of_channels = layout->number_of_channels;
+
+  float *inputs[MAX_CHANNELS] = {NULL};
+  float *outputs[MAX_CHANNELS] = {NULL};
+  for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+    inputs[channel] = (float *)calloc(block_size, sizeof(float));
+    outputs[channel] = setting->in_place
+                           ? inputs[channel]
+                           : (float *)calloc(block_size, sizeof(float));
+  }
+
+  lv2_plugin_connect_audio(plugin, (const float *const *)inputs, outputs);
+  lv2_plugin_activate(plugin);
+
+  uint64_t position = 0U;
+
+  // Manual profile plugins need a profile before they do any reduction
+  const uint32_t preroll_cycles =
+      (uint32_t)(PREROLL_SECONDS * (float)sample_rate) / block_size + 1U;
+  set_control(plugin, layout->learn_port, 1.F);
+  for (uint32_t cycle = 0U; cycle < preroll_cycles; cycle++) {
+    fill_inputs(signal, sample_rate, &position, inputs, number_of_channels,
+                block_size);
+    lv2_plugin_run(plugin, block_size);
+    lv2_plugin_run_worker(plugin);
+  }
+
+  set_control(plugin, layout->learn_port, setting->learn);
+  set_control(plugin, layout->enable_port, setting->enable);
+  set_control(plugin, layout->residual_listen_port, setting->residual_listen);
+  set_control(plugin, layout->parallel_port, setting->parallel);
+
+  uint32_t cycles = (uint32_t)(seconds * (float)sample_rate) / block_size;
+  if (cycles < 16U) {
+    cycles = 16U;
+  }
+
+  uint64_t total_ns = 0U;
+  uint64_t worst_ns = 0U;
+  const unsigned long allocations_before = allocation_counter_get_count();
+
+  for (uint32_t cycle = 0U; cycle < cycles; cycle++) {
+    fill_inputs(signal, sample_rate, &position, inputs, number_of_channels,
+                block_size);
+
+    allocation_counter_set_enabled(true);
+    const uint64_t start = get_time_ns();
+    lv2_plugin_run(plugin, block_size);
+    const uint64_t elapsed = get_time_ns() - start;
+    allocation_counter_set_enabled(false);
+
+    total_ns += elapsed;
+    if (elapsed > worst_ns) {
+      worst_ns = elapsed;
+    }
+
+    lv2_plugin_run_worker(plugin);
+  }
+
+  const unsigned long run_allocations =
+      allocation_counter_get_count() - allocations_before;
+
+  result->nanoseconds_per_sample =
+      (double)total_ns / ((double)cycles * (double)block_size);
+  result->worst_cycle_microseconds = (double)worst_ns / 1000.0;
+  result->allocations_per_cycle = (double)run_allocations / (double)cycles;
+
+  lv2_plugin_free(plugin);
+  for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+    if (outputs[channel] != inputs[channel]) {
+      free(outputs[channel]);
+    }
+    free(inputs[channel]);
+  }
+
+  return true;
+}
+
+static void benchmark_descriptor(const LV2_Descriptor *descriptor,
+                                 const float seconds) {
+  const PluginLayout *layout = plugin_layout_find(descriptor->URI);
+  if (!layout) {
+    fprintf(stderr, "Skipping unknown plugin <%s>\n", descriptor->URI);
+    return;
+  }
+
+  for (size_t r = 0U; r < sizeof(sample_rates) / sizeof(sample_rates[0]);
+       r++) {
+    float *signal = generate_signal(sample_rates[r]);
+    if (!signal) {
+      return;
+    }
+
+    for (uint32_t block_size = MIN_BLOCK_SIZE; block_size <= MAX_BLOCK_SIZE;
+         block_size *= 2U) {
+      for (size_t s = 0U; s < sizeof(settings) / sizeof(settings[0]); s++) {
+        if (!setting_applies(&settings[s], layout)) {
+          continue;
+        }
+
+        BenchmarkResult result;
+        if (!run_benchmark(descriptor, sample_rates[r], block_size,
+                           &settings[s], seconds, signal, &result)) {
+          fprintf(stderr, "Unable to instantiate <%s>\n", descriptor->URI);
+          free(signal);
+          return;
+        }
+
+        printf("%-62s %6u %5u %-9s %10.2f %12.2f", descriptor->URI,
+               sample_rates[r], block_size, settings[s].name,
+               result.nanoseconds_per_sample, result.worst_cycle_microseconds);
+        if (allocation_counter_is_available()) {
+          printf(" %12.3f\n", result.allocations_per_cycle);
+        } else {
+          printf(" %12s\n", "n/a");
+        }
+        fflush(stdout);
+      }
+    }
+
+    free(signal);
+  }
+}
+
+int main(int argc, char **argv) {
+  float seconds = DEFAULT_SECONDS;
+  int first_library = 1;
+
+  if (argc > 2 && strcmp(argv[1], "-s") == 0) {
+    seconds = strtof(argv[2], NULL);
+    first_library = 3;
+  }
+
+  if (first_library >= argc || seconds <= 0.F) {
+    fprintf(stderr, "Usage: %s [-s seconds] plugin-library...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  printf("%-62s %6s %5s %-9s %10s %12s %12s\n", "plugin", "rate", "block",
+         "setting", "ns/sample", "worst us", "allocs/cycle");
+
+  for (int i = first_library; i < argc; i++) {
+    void *library = lv2_library_open(argv[i]);
+    if (!library) {
+      return EXIT_FAILURE;
+    }
+
+    const LV2_Descriptor *descriptor = NULL;
+    for (uint32_t index = 0U;
+         (descriptor = lv2_library_get_descriptor(library, index)); index++) {
+      benchmark_descriptor(descriptor, seconds);
+    }
+
+    lv2_library_close(library);
+  }
+
+  return EXIT_SUCCESS;
+}
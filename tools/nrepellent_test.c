@@ -0,0 +1,828 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _GNU_SOURCE
+
+#include "allocation_counter.h"
+#include "lv2_host.h"
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TEST_SAMPLE_RATE 48000U
+#define TEST_BLOCK_SIZE 256U
+#define LEARN_SECONDS 1.F
+#define SETTLE_SECONDS 1.F
+#define MEASURE_SECONDS 0.5F
+#define STATE_FILE_PATH "nrepellent-test.state"
+#ifndef GOLDEN_OUTPUT_DIR
+#define GOLDEN_OUTPUT_DIR "tools/golden"
+#endif
+
+// Clean and residual output come from the same gains, so their sum only
+// differs from the input by the reconstruction error of the denoiser
+#define MAX_RESIDUAL_ERROR_DB -40.F
+// On top of it the halfband pair of the speech band only rebuilds the input to
+// about -36 dB
+#define MAX_SPEECH_BAND_RESIDUAL_ERROR_DB -30.F
+// Silent input has to come out silent, whatever the denoisers were fed before
+#define MAX_SILENT_OUTPUT 1e-6F
+
+// Block levels of a recorded golden output may drift by rounding across
+// compilers and FFT builds, not by any change of the processing itself
+#define MAX_GOLDEN_DEVIATION_DB 0.5F
+#define GOLDEN_FLOOR_DB -120.F
+#define GOLDEN_BLOCKS 64U
+#define GOLDEN_PATH_SIZE 1024U
+
+// Exit status meson reports as a skipped test
+#define EXIT_SKIPPED 77
+
+typedef enum TestResult {
+  TEST_PASSED = 0,
+  TEST_FAILED = 1,
+  TEST_SKIPPED = 2,
+} TestResult;
+
+typedef TestResult (*TestFunction)(const LV2_Descriptor *descriptor);
+
+typedef struct Test {
+  const char *name;
+  TestFunction function;
+} Test;
+
+typedef struct Fixture {
+  Lv2Plugin *plugin;
+  const PluginLayout *layout;
+  float *inputs[MAX_CHANNELS];
+  float *outputs[MAX_CHANNELS];
+  uint64_t position;
+  bool count_allocations;
+  bool silent;
+} Fixture;
+
+// White noise over a tone, different on every channel and computed from the
+// sample position alone, so any delayed copy of the input can be rebuilt
+static float test_signal(const uint32_t channel, const uint64_t position) {
+  uint32_t seed = (uint32_t)position * 2654435761U ^ (channel + 1U) * 40503U;
+  seed ^= seed >> 15U;
+  seed *= 2246822519U;
+  seed ^= seed >> 13U;
+
+  const double phase = 2.0 * M_PI * 220.0 * (double)(channel + 1U) *
+                       (double)position / (double)TEST_SAMPLE_RATE;
+  const float noise = (float)(seed >> 8U) / 8388608.F - 1.F;
+
+  return 0.05F * noise + 0.3F * (float)sin(phase);
+}
+
+// The input a plugin with the given latency is expected to output
+static float delayed_signal(const uint32_t channel, const uint64_t position,
+                            const uint32_t latency) {
+  return position >= latency ? test_signal(channel, position - latency) : 0.F;
+}
+
+static uint32_t seconds_to_blocks(const float seconds) {
+  return (uint32_t)(seconds * (float)TEST_SAMPLE_RATE) / TEST_BLOCK_SIZE;
+}
+
+static void fixture_free(Fixture *self) {
+  if (self->plugin) {
+    lv2_plugin_free(self->plugin);
+  }
+
+  for (uint32_t channel = 0U; channel < MAX_CHANNELS; channel++) {
+    if (self->outputs[channel] != self->inputs[channel]) {
+      free(self->outputs[channel]);
+    }
+    free(self->inputs[channel]);
+  }
+}
+
+static bool fixture_initialize(Fixture *self,
+                               const LV2_Descriptor *descriptor,
+                               const bool in_place) {
+  memset(self, 0, sizeof(Fixture));
+
+  self->plugin = lv2_plugin_initialize(descriptor, (double)TEST_SAMPLE_RATE,
+                                       TEST_BLOCK_SIZE);
+  if (!self->plugin) {
+    return false;
+  }
+  self->layout = lv2_plugin_get_layout(self->plugin);
+
+  for (uint32_t channel = 0U; channel < self->layout->number_of_channels;
+       channel++) {
+    self->inputs[channel] = (float *)calloc(TEST_BLOCK_SIZE, sizeof(float));
+    self->outputs[channel] =
+        in_place ? self->inputs[channel]
+                 : (float *)calloc(TEST_BLOCK_SIZE, sizeof(float));
+    if (!self->inputs[channel] || !self->outputs[channel]) {
+      fixture_free(self);
+      return false;
+    }
+  }
+
+  lv2_plugin_connect_audio(self->plugin, (const float *const *)self->inputs,
+                           self->outputs);
+  lv2_plugin_activate(self->plugin);
+
+  return true;
+}
+
+static void fixture_set_control(Fixture *self, const uint32_t port,
+                                const float value) {
+  if (port != NO_PORT) {
+    lv2_plugin_set_control(self->plugin, port, value);
+  }
+}
+
+static uint32_t fixture_get_latency(const Fixture *self) {
+  return (uint32_t)lv2_plugin_get_control(self->plugin,
+                                          self->layout->latency_port);
+}
+
+// One cycle of the test signal, leaving scheduled work queued
+static void fixture_render(Fixture *self) {
+  for (uint32_t channel = 0U; channel < self->layout->number_of_channels;
+       channel++) {
+    for (uint32_t k = 0U; k < TEST_BLOCK_SIZE; k++) {
+      self->inputs[channel][k] =
+          self->silent ? 0.F : test_signal(channel, self->position + k);
+    }
+  }
+
+  allocation_counter_set_enabled(self->count_allocations);
+  lv2_plugin_run(self->plugin, TEST_BLOCK_SIZE);
+  allocation_counter_set_enabled(false);
+
+  self->position += TEST_BLOCK_SIZE;
+}
+
+// The worker runs after each cycle as a host would do it from its own thread
+static void fixture_run(Fixture *self) {
+  fixture_render(self);
+  lv2_plugin_run_worker(self->plugin);
+}
+
+static void fixture_run_seconds(Fixture *self, const float seconds) {
+  const uint32_t blocks = seconds_to_blocks(seconds);
+  for (uint32_t block = 0U; block < blocks; block++) {
+    fixture_run(self);
+  }
+}
+
+// Loudest output sample of any channel over the given time
+static float fixture_run_peak(Fixture *self, const float seconds) {
+  float peak = 0.F;
+  const uint32_t blocks = seconds_to_blocks(seconds);
+  for (uint32_t block = 0U; block < blocks; block++) {
+    fixture_run(self);
+    for (uint32_t channel = 0U; channel < self->layout->number_of_channels;
+         channel++) {
+      for (uint32_t k = 0U; k < TEST_BLOCK_SIZE; k++) {
+        peak = fmaxf(peak, fabsf(self->outputs[channel][k]));
+      }
+    }
+  }
+  return peak;
+}
+
+// Manual plugins only reduce noise once they hold a profile
+static void fixture_learn_noise(Fixture *self) {
+  if (self->layout->learn_port == NO_PORT) {
+    return;
+  }
+
+  fixture_set_control(self, self->layout->learn_port, 1.F);
+  fixture_run_seconds(self, LEARN_SECONDS);
+  fixture_set_control(self, self->layout->learn_port, 0.F);
+}
+
+// Once the fade has settled on dry, the output is the input delayed by the
+// reported latency, down to the last bit
+static TestResult check_bypass(const LV2_Descriptor *descriptor,
+                               const bool in_place) {
+  Fixture fixture;
+  if (!fixture_initialize(&fixture, descriptor, in_place)) {
+    return TEST_FAILED;
+  }
+
+  fixture_learn_noise(&fixture);
+  fixture_run_seconds(&fixture, SETTLE_SECONDS);
+  fixture_set_control(&fixture, fixture.layout->enable_port, 0.F);
+  fixture_run_seconds(&fixture, SETTLE_SECONDS);
+
+  const uint32_t latency = fixture_get_latency(&fixture);
+  uint64_t mismatches = 0U;
+
+  const uint32_t blocks = seconds_to_blocks(MEASURE_SECONDS);
+  for (uint32_t block = 0U; block < blocks; block++) {
+    const uint64_t start = fixture.position;
+    fixture_run(&fixture);
+
+    for (uint32_t channel = 0U; channel < fixture.layout->number_of_channels;
+         channel++) {
+      for (uint32_t k = 0U; k < TEST_BLOCK_SIZE; k++) {
+        if (fixture.outputs[channel][k] !=
+            delayed_signal(channel, start + k, latency)) {
+          mismatches++;
+        }
+      }
+    }
+  }
+
+  fixture_free(&fixture);
+
+  if (mismatches > 0U) {
+    fprintf(stderr, "%llu bypassed samples differ from the dry input%s\n",
+            (unsigned long long)mismatches, in_place ? " in place" : "");
+    return TEST_FAILED;
+  }
+
+  return TEST_PASSED;
+}
+
+static TestResult test_bypass(const LV2_Descriptor *descriptor) {
+  if (check_bypass(descriptor, false) != TEST_PASSED) {
+    return TEST_FAILED;
+  }
+  return check_bypass(descriptor, true);
+}
+
+// Finds the delay of the first channel by cross correlating its output with
+// the input over lags up to a few times the reported latency
+static uint32_t measure_delay(Fixture *self, const uint32_t max_lag) {
+  const uint32_t blocks = seconds_to_blocks(MEASURE_SECONDS);
+  const uint32_t length = blocks * TEST_BLOCK_SIZE;
+  float *output = (float *)calloc(length, sizeof(float));
+  float *input = (float *)calloc(length + max_lag, sizeof(float));
+  if (!output || !input) {
+    free(output);
+    free(input);
+    return UINT32_MAX;
+  }
+
+  const uint64_t start = self->position;
+  for (uint32_t k = 0U; k < length + max_lag; k++) {
+    input[k] = delayed_signal(0U, start + k, max_lag);
+  }
+
+  for (uint32_t block = 0U; block < blocks; block++) {
+    fixture_run(self);
+    memcpy(&output[block * TEST_BLOCK_SIZE], self->outputs[0],
+           sizeof(float) * TEST_BLOCK_SIZE);
+  }
+
+  uint32_t delay = 0U;
+  double best_correlation = -INFINITY;
+  for (uint32_t lag = 0U; lag <= max_lag; lag++) {
+    double correlation = 0.0;
+    for (uint32_t k = 0U; k < length; k++) {
+      correlation += (double)output[k] * (double)input[k + max_lag - lag];
+    }
+    if (correlation > best_correlation) {
+      best_correlation = correlation;
+      delay = lag;
+    }
+  }
+
+  free(output);
+  free(input);
+
+  return delay;
+}
+
+// Without reduction the denoised output is the input delayed by the latency
+static TestResult check_latency(const LV2_Descriptor *descriptor,
+                                const bool speech_band) {
+  Fixture fixture;
+  if (!fixture_initialize(&fixture, descriptor, false)) {
+    return TEST_FAILED;
+  }
+
+  fixture_learn_noise(&fixture);
+  fixture_set_control(&fixture, fixture.layout->reduction_port, 0.F);
+  fixture_set_control(&fixture, fixture.layout->speech_band_port,
+                      speech_band ? 1.F : 0.F);
+  fixture_run_seconds(&fixture, SETTLE_SECONDS);
+
+  const uint32_t latency = fixture_get_latency(&fixture);
+  const uint32_t delay = measure_delay(&fixture, 4U * latency + 64U);
+  fixture_free(&fixture);
+
+  if (delay != latency) {
+    fprintf(stderr, "Reported latency %u but output is delayed by %u%s\n",
+            latency, delay, speech_band ? " in speech band mode" : "");
+    return TEST_FAILED;
+  }
+
+  return TEST_PASSED;
+}
+
+static TestResult test_latency(const LV2_Descriptor *descriptor) {
+  const PluginLayout *layout = plugin_layout_find(descriptor->URI);
+  if (check_latency(descriptor, false) != TEST_PASSED) {
+    return TEST_FAILED;
+  }
+  if (layout->speech_band_port != NO_PORT) {
+    return check_latency(descriptor, true);
+  }
+  return TEST_PASSED;
+}
+
+// Two instances fed the same input, one of them listening to the residual,
+// must add up to the delayed input
+static TestResult check_residual(const LV2_Descriptor *descriptor,
+                                 const bool speech_band) {
+  Fixture fixtures[2];
+  if (!fixture_initialize(&fixtures[0], descriptor, false)) {
+    return TEST_FAILED;
+  }
+  if (!fixture_initialize(&fixtures[1], descriptor, false)) {
+    fixture_free(&fixtures[0]);
+    return TEST_FAILED;
+  }
+
+  const PluginLayout *layout = fixtures[0].layout;
+  fixture_set_control(&fixtures[1], layout->residual_listen_port, 1.F);
+  for (uint32_t i = 0U; i < 2U; i++) {
+    fixture_learn_noise(&fixtures[i]);
+    fixture_set_control(&fixtures[i], layout->speech_band_port,
+                        speech_band ? 1.F : 0.F);
+    fixture_run_seconds(&fixtures[i], SETTLE_SECONDS);
+  }
+
+  const uint32_t latency = fixture_get_latency(&fixtures[0]);
+  double error = 0.0;
+  double energy = 0.0;
+
+  const uint32_t blocks = seconds_to_blocks(MEASURE_SECONDS);
+  for (uint32_t block = 0U; block < blocks; block++) {
+    const uint64_t start = fixtures[0].position;
+    fixture_run(&fixtures[0]);
+    fixture_run(&fixtures[1]);
+
+    for (uint32_t channel = 0U; channel < layout->number_of_channels;
+         channel++) {
+      for (uint32_t k = 0U; k < TEST_BLOCK_SIZE; k++) {
+        const double expected = delayed_signal(channel, start + k, latency);
+        const double sum = (double)fixtures[0].outputs[channel][k] +
+                           (double)fixtures[1].outputs[channel][k];
+        error += (sum - expected) * (sum - expected);
+        energy += expected * expected;
+      }
+    }
+  }
+
+  fixture_free(&fixtures[0]);
+  fixture_free(&fixtures[1]);
+
+  const double error_db = 10.0 * log10(error / energy + 1e-30);
+  if (error_db > (speech_band ? MAX_SPEECH_BAND_RESIDUAL_ERROR_DB
+                              : MAX_RESIDUAL_ERROR_DB)) {
+    fprintf(stderr, "Clean plus residual output is %.1f dB off the input%s\n",
+            error_db, speech_band ? " in speech band mode" : "");
+    return TEST_FAILED;
+  }
+
+  return TEST_PASSED;
+}
+
+static TestResult test_residual(const LV2_Descriptor *descriptor) {
+  const PluginLayout *layout = plugin_layout_find(descriptor->URI);
+  if (check_residual(descriptor, false) != TEST_PASSED) {
+    return TEST_FAILED;
+  }
+  if (layout->speech_band_port != NO_PORT) {
+    return check_residual(descriptor, true);
+  }
+  return TEST_PASSED;
+}
+
+// Sessions saved before every channel had a key of its own hold only the first
+// profile, which then goes to every channel
+static TestResult check_legacy_state(const LV2_Descriptor *descriptor,
+                                     Lv2State *saved) {
+  uint32_t size = 0U;
+  const void *first = lv2_state_get_value(saved, "#noiseprofile", &size);
+  if (!first || !lv2_state_remove_value(saved, "#noiseprofile2")) {
+    return TEST_PASSED;
+  }
+
+  Lv2Plugin *restored = lv2_plugin_initialize(
+      descriptor, (double)TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+  Lv2State *saved_again = NULL;
+  uint32_t second_size = 0U;
+  const void *second = NULL;
+  if (restored && lv2_plugin_restore_state(restored, saved) &&
+      (saved_again = lv2_plugin_save_state(restored))) {
+    second = lv2_state_get_value(saved_again, "#noiseprofile2", &second_size);
+  }
+
+  const bool restored_first =
+      second && second_size == size && memcmp(first, second, size) == 0;
+  lv2_state_free(saved_again);
+  if (restored) {
+    lv2_plugin_free(restored);
+  }
+
+  if (!restored_first) {
+    fprintf(stderr, "State without a second profile was not restored\n");
+    return TEST_FAILED;
+  }
+
+  return TEST_PASSED;
+}
+
+// Denoisers warmed up with a restored history still hold the end of it, which
+// must not reach an instance that is fed silence by then. Switching the band
+// mode along with the restore replays it through denoisers of the other mode
+static TestResult check_warm_start_silence(const LV2_Descriptor *descriptor,
+                                           const Lv2State *saved,
+                                           const bool switch_band) {
+  Fixture fixture;
+  if (!fixture_initialize(&fixture, descriptor, false)) {
+    return TEST_FAILED;
+  }
+
+  fixture.silent = true;
+  fixture_set_control(&fixture, fixture.layout->warm_start_port, 1.F);
+  fixture_run_seconds(&fixture, SETTLE_SECONDS);
+
+  float peak = INFINITY;
+  if (lv2_plugin_restore_state(fixture.plugin, saved)) {
+    fixture_set_control(&fixture, fixture.layout->speech_band_port,
+                        switch_band ? 1.F : 0.F);
+    peak = fixture_run_peak(&fixture, SETTLE_SECONDS);
+  }
+  fixture_free(&fixture);
+
+  if (!(peak <= MAX_SILENT_OUTPUT)) {
+    fprintf(stderr, "Silent input came out at %g after a warm start%s\n",
+            (double)peak, switch_band ? " and a band switch" : "");
+    return TEST_FAILED;
+  }
+
+  return TEST_PASSED;
+}
+
+// What an instance restores and saves again must match what was saved,
+// including after a trip through a state file
+static TestResult test_state(const LV2_Descriptor *descriptor) {
+  Fixture fixture;
+  if (!fixture_initialize(&fixture, descriptor, false)) {
+    return TEST_FAILED;
+  }
+
+  const PluginLayout *layout = fixture.layout;
+  if (layout->warm_start_port != NO_PORT) {
+    // Program audio is only saved when asked for
+    fixture_run_seconds(&fixture, SETTLE_SECONDS);
+    Lv2State *unwanted = lv2_plugin_save_state(fixture.plugin);
+    if (unwanted) {
+      fprintf(stderr, "Input history saved without warm start\n");
+      lv2_state_free(unwanted);
+      fixture_free(&fixture);
+      return TEST_FAILED;
+    }
+    fixture_set_control(&fixture, layout->warm_start_port, 1.F);
+  }
+
+  fixture_learn_noise(&fixture);
+  // The learn pass ends with this cycle, before the worker finishes it
+  fixture_render(&fixture);
+  Lv2State *saved = lv2_plugin_save_state(fixture.plugin);
+  if (!saved) {
+    fprintf(stderr, "Nothing was saved\n");
+    fixture_free(&fixture);
+    return TEST_FAILED;
+  }
+
+  TestResult result = TEST_PASSED;
+
+  // Saving early must not store anything but what the plugin ends up with
+  if (layout->learn_port != NO_PORT) {
+    lv2_plugin_run_worker(fixture.plugin);
+    fixture_run(&fixture);
+    Lv2State *settled = lv2_plugin_save_state(fixture.plugin);
+    if (!settled || !lv2_state_equal(saved, settled)) {
+      fprintf(stderr, "State saved while the worker was busy differs\n");
+      result = TEST_FAILED;
+    }
+    lv2_state_free(settled);
+  }
+  fixture_free(&fixture);
+
+  Lv2State *read = NULL;
+  if (!lv2_state_write(saved, STATE_FILE_PATH) ||
+      !(read = lv2_state_read(STATE_FILE_PATH)) ||
+      !lv2_state_equal(saved, read)) {
+    fprintf(stderr, "State changed through a state file\n");
+    result = TEST_FAILED;
+  }
+  lv2_state_free(read);
+  remove(STATE_FILE_PATH);
+
+  // Hosts may restore before activating
+  Lv2Plugin *restored = lv2_plugin_initialize(
+      descriptor, (double)TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+  Lv2State *saved_again = NULL;
+  if (restored && layout->warm_start_port != NO_PORT) {
+    lv2_plugin_set_control(restored, layout->warm_start_port, 1.F);
+  }
+  if (!restored || !lv2_plugin_restore_state(restored, saved) ||
+      !(saved_again = lv2_plugin_save_state(restored)) ||
+      !lv2_state_equal(saved, saved_again)) {
+    fprintf(stderr, "Restored state does not match the saved one\n");
+    result = TEST_FAILED;
+  }
+
+  lv2_state_free(saved_again);
+  if (restored) {
+    lv2_plugin_free(restored);
+  }
+
+  if (layout->warm_start_port != NO_PORT &&
+      check_warm_start_silence(descriptor, saved, false) != TEST_PASSED) {
+    result = TEST_FAILED;
+  }
+  if (layout->warm_start_port != NO_PORT &&
+      layout->speech_band_port != NO_PORT &&
+      check_warm_start_silence(descriptor, saved, true) != TEST_PASSED) {
+    result = TEST_FAILED;
+  }
+  if (check_legacy_state(descriptor, saved) != TEST_PASSED) {
+    result = TEST_FAILED;
+  }
+  lv2_state_free(saved);
+
+  return result;
+}
+
+typedef struct RunCounts {
+  unsigned long allocations;
+  unsigned long locks;
+} RunCounts;
+
+// Drives the run paths a session goes through, counting what run() allocates
+// and the locks it may block on
+static RunCounts count_run_allocations(const LV2_Descriptor *descriptor,
+                                       const bool in_place) {
+  Fixture fixture;
+  if (!fixture_initialize(&fixture, descriptor, in_place)) {
+    return (RunCounts){ULONG_MAX, ULONG_MAX};
+  }
+
+  const PluginLayout *layout = fixture.layout;
+  const unsigned long allocations_before = allocation_counter_get_count();
+  const unsigned long locks_before = allocation_counter_get_lock_count();
+  fixture.count_allocations = true;
+
+  fixture_learn_noise(&fixture);
+  fixture_run_seconds(&fixture, MEASURE_SECONDS);
+  fixture_set_control(&fixture, layout->residual_listen_port, 1.F);
+  fixture_run_seconds(&fixture, MEASURE_SECONDS);
+  fixture_set_control(&fixture, layout->residual_listen_port, 0.F);
+  fixture_set_control(&fixture, layout->enable_port, 0.F);
+  fixture_run_seconds(&fixture, MEASURE_SECONDS);
+  fixture_set_control(&fixture, layout->enable_port, 1.F);
+  fixture_set_control(&fixture, layout->parallel_port, 1.F);
+  fixture_run_seconds(&fixture, MEASURE_SECONDS);
+  fixture_set_control(&fixture, layout->speech_band_port, 1.F);
+  fixture_run_seconds(&fixture, MEASURE_SECONDS);
+  fixture_set_control(&fixture, layout->free_wheeling_port, 1.F);
+  fixture_run_seconds(&fixture, MEASURE_SECONDS);
+
+  const RunCounts counts = {
+      allocation_counter_get_count() - allocations_before,
+      allocation_counter_get_lock_count() - locks_before,
+  };
+  fixture_free(&fixture);
+
+  return counts;
+}
+
+static TestResult test_allocations(const LV2_Descriptor *descriptor) {
+  if (!allocation_counter_is_available()) {
+    return TEST_SKIPPED;
+  }
+
+  for (uint32_t i = 0U; i < 2U; i++) {
+    const RunCounts counts = count_run_allocations(descriptor, i == 1U);
+    if (counts.allocations > 0U || counts.locks > 0U) {
+      fprintf(stderr, "run() allocated %lu times and locked %lu times%s\n",
+              counts.allocations, counts.locks, i == 1U ? " in place" : "");
+      return TEST_FAILED;
+    }
+  }
+
+  return TEST_PASSED;
+}
+
+// Level in dB of every output block once a session has settled, which is
+// what a golden output is recorded and compared with
+static bool render_golden_levels(const LV2_Descriptor *descriptor,
+                                 float *levels) {
+  Fixture fixture;
+  if (!fixture_initialize(&fixture, descriptor, false)) {
+    return false;
+  }
+
+  fixture_learn_noise(&fixture);
+  fixture_run_seconds(&fixture, SETTLE_SECONDS);
+
+  for (uint32_t block = 0U; block < GOLDEN_BLOCKS; block++) {
+    fixture_run(&fixture);
+
+    double energy = 0.0;
+    for (uint32_t channel = 0U; channel < fixture.layout->number_of_channels;
+         channel++) {
+      for (uint32_t k = 0U; k < TEST_BLOCK_SIZE; k++) {
+        const double sample = (double)fixture.outputs[channel][k];
+        energy += sample * sample;
+      }
+    }
+    energy /= (double)(fixture.layout->number_of_channels * TEST_BLOCK_SIZE);
+
+    levels[block] =
+        fmaxf(10.F * log10f((float)energy + 1e-30F), GOLDEN_FLOOR_DB);
+  }
+
+  fixture_free(&fixture);
+
+  return true;
+}
+
+// One reference per plugin, named after the end of its URI
+static void golden_output_path(const LV2_Descriptor *descriptor, char *path,
+                               const size_t size) {
+  const char *name = strrchr(descriptor->URI, '/');
+  name = name ? name + 1 : descriptor->URI;
+
+  const int length = snprintf(path, size, "%s/%s.txt", GOLDEN_OUTPUT_DIR, name);
+  if (length < 0 || (size_t)length >= size) {
+    path[0] = '\0';
+    return;
+  }
+
+  for (char *c = path + strlen(GOLDEN_OUTPUT_DIR) + 1U; *c; c++) {
+    if (*c != '.' && !isalnum((unsigned char)*c)) {
+      *c = '-';
+    }
+  }
+}
+
+static TestResult test_golden(const LV2_Descriptor *descriptor) {
+  char path[GOLDEN_PATH_SIZE];
+  golden_output_path(descriptor, path, sizeof(path));
+
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "No golden output at %s, record it with record-golden\n",
+            path);
+    return TEST_SKIPPED;
+  }
+
+  float expected[GOLDEN_BLOCKS];
+  uint32_t read = 0U;
+  while (read < GOLDEN_BLOCKS && fscanf(file, "%f", &expected[read]) == 1) {
+    read++;
+  }
+  fclose(file);
+
+  if (read != GOLDEN_BLOCKS) {
+    fprintf(stderr, "%s holds %u of %u block levels\n", path, read,
+            GOLDEN_BLOCKS);
+    return TEST_FAILED;
+  }
+
+  float levels[GOLDEN_BLOCKS];
+  if (!render_golden_levels(descriptor, levels)) {
+    return TEST_FAILED;
+  }
+
+  uint32_t deviations = 0U;
+  float worst = 0.F;
+  for (uint32_t block = 0U; block < GOLDEN_BLOCKS; block++) {
+    const float deviation = fabsf(levels[block] - expected[block]);
+    worst = fmaxf(worst, deviation);
+    deviations += deviation > MAX_GOLDEN_DEVIATION_DB ? 1U : 0U;
+  }
+
+  if (deviations > 0U) {
+    fprintf(stderr, "%u blocks deviate from %s, by up to %.2f dB\n",
+            deviations, path, (double)worst);
+    return TEST_FAILED;
+  }
+
+  return TEST_PASSED;
+}
+
+// Rewrites the references, to be run by hand against the libspecbleach
+// revision the build pins
+static TestResult test_record_golden(const LV2_Descriptor *descriptor) {
+  float levels[GOLDEN_BLOCKS];
+  if (!render_golden_levels(descriptor, levels)) {
+    return TEST_FAILED;
+  }
+
+  char path[GOLDEN_PATH_SIZE];
+  golden_output_path(descriptor, path, sizeof(path));
+
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    fprintf(stderr, "Could not write %s\n", path);
+    return TEST_FAILED;
+  }
+  for (uint32_t block = 0U; block < GOLDEN_BLOCKS; block++) {
+    fprintf(file, "%.3f\n", (double)levels[block]);
+  }
+
+  return fclose(file) == 0 ? TEST_PASSED : TEST_FAILED;
+}
+
+static const Test tests[] = {
+    {"bypass", test_bypass},     {"latency", test_latency},
+    {"residual", test_residual}, {"state", test_state},
+    {"allocations", test_allocations}, {"golden", test_golden},
+    {"record-golden", test_record_golden},
+};
+
+static const Test *find_test(const char *name) {
+  for (size_t i = 0U; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    if (strcmp(tests[i].name, name) == 0) {
+      return &tests[i];
+    }
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  const Test *test = argc > 2 ? find_test(argv[1]) : NULL;
+  if (!test) {
+    fprintf(stderr, "Usage: %s test plugin-library...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  uint32_t failed = 0U;
+  uint32_t skipped = 0U;
+  uint32_t total = 0U;
+
+  for (int i = 2; i < argc; i++) {
+    void *library = lv2_library_open(argv[i]);
+    if (!library) {
+      return EXIT_FAILURE;
+    }
+
+    const LV2_Descriptor *descriptor = NULL;
+    for (uint32_t index = 0U;
+         (descriptor = lv2_library_get_descriptor(library, index)); index++) {
+      TestResult result = TEST_FAILED;
+      if (!plugin_layout_find(descriptor->URI)) {
+        fprintf(stderr, "No port layout for <%s>\n", descriptor->URI);
+      } else {
+        result = test->function(descriptor);
+      }
+
+      static const char *const result_names[] = {"ok", "FAILED", "skipped"};
+      printf("%s %s: %s\n", test->name, descriptor->URI, result_names[result]);
+      fflush(stdout);
+
+      total++;
+      failed += result == TEST_FAILED ? 1U : 0U;
+      skipped += result == TEST_SKIPPED ? 1U : 0U;
+    }
+
+    lv2_library_close(library);
+  }
+
+  if (failed > 0U) {
+    return EXIT_FAILURE;
+  }
+  return skipped == total ? EXIT_SKIPPED : EXIT_SUCCESS;
+}
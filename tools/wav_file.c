@@ -0,0 +1,391 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _GNU_SOURCE
+
+#include "wav_file.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WAVE_FORMAT_PCM 1U
+#define WAVE_FORMAT_IEEE_FLOAT 3U
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFEU
+#define WAV_HEADER_SIZE 44U
+#define WRITE_BUFFER_SIZE (1U << 20U)
+
+struct WavReader {
+  WavInfo info;
+  uint8_t *mapping;
+  size_t mapping_size;
+  const uint8_t *data;
+  uint32_t bytes_per_sample;
+  uint64_t position;
+};
+
+struct WavWriter {
+  WavInfo info;
+  FILE *file;
+  uint32_t bytes_per_sample;
+  uint64_t data_size;
+  uint8_t *block;
+  size_t block_size;
+};
+
+static uint32_t read_u16(const uint8_t *bytes) {
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8U);
+}
+
+static uint32_t read_u32(const uint8_t *bytes) {
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8U) |
+         ((uint32_t)bytes[2] << 16U) | ((uint32_t)bytes[3] << 24U);
+}
+
+static void write_u16(uint8_t *bytes, const uint32_t value) {
+  bytes[0] = (uint8_t)value;
+  bytes[1] = (uint8_t)(value >> 8U);
+}
+
+static void write_u32(uint8_t *bytes, const uint32_t value) {
+  write_u16(bytes, value);
+  write_u16(&bytes[2], value >> 16U);
+}
+
+static uint32_t get_bytes_per_sample(const WavSampleFormat format) {
+  switch (format) {
+  case WAV_PCM_16:
+    return 2U;
+  case WAV_PCM_24:
+    return 3U;
+  default:
+    return 4U;
+  }
+}
+
+static bool parse_format(WavInfo *info, const uint8_t *chunk,
+                         const uint32_t chunk_size) {
+  if (chunk_size < 16U) {
+    return false;
+  }
+
+  uint32_t format_tag = read_u16(chunk);
+  info->number_of_channels = read_u16(&chunk[2]);
+  info->sample_rate = read_u32(&chunk[4]);
+  const uint32_t bits_per_sample = read_u16(&chunk[14]);
+
+  // The sub format guid starts with the plain format tag
+  if (format_tag == WAVE_FORMAT_EXTENSIBLE) {
+    if (chunk_size < 40U) {
+      return false;
+    }
+    format_tag = read_u16(&chunk[24]);
+  }
+
+  if (format_tag == WAVE_FORMAT_PCM && bits_per_sample == 16U) {
+    info->format = WAV_PCM_16;
+  } else if (format_tag == WAVE_FORMAT_PCM && bits_per_sample == 24U) {
+    info->format = WAV_PCM_24;
+  } else if (format_tag == WAVE_FORMAT_PCM && bits_per_sample == 32U) {
+    info->format = WAV_PCM_32;
+  } else if (format_tag == WAVE_FORMAT_IEEE_FLOAT && bits_per_sample == 32U) {
+    info->format = WAV_FLOAT_32;
+  } else {
+    return false;
+  }
+
+  return info->number_of_channels > 0U && info->sample_rate > 0U;
+}
+
+static bool parse_chunks(WavReader *self) {
+  const uint8_t *bytes = self->mapping;
+  const size_t size = self->mapping_size;
+
+  if (size < 12U || memcmp(bytes, "RIFF", 4U) != 0 ||
+      memcmp(&bytes[8], "WAVE", 4U) != 0) {
+    return false;
+  }
+
+  bool format_found = false;
+  size_t offset = 12U;
+
+  while (offset + 8U <= size) {
+    const uint8_t *chunk = &bytes[offset + 8U];
+    size_t chunk_size = read_u32(&bytes[offset + 4U]);
+    if (chunk_size > size - offset - 8U) {
+      chunk_size = size - offset - 8U;
+    }
+
+    if (memcmp(&bytes[offset], "fmt ", 4U) == 0) {
+      format_found = parse_format(&self->info, chunk, (uint32_t)chunk_size);
+      if (!format_found) {
+        return false;
+      }
+    } else if (memcmp(&bytes[offset], "data", 4U) == 0 && format_found) {
+      self->bytes_per_sample = get_bytes_per_sample(self->info.format);
+      self->data = chunk;
+      self->info.number_of_frames =
+          chunk_size /
+          ((size_t)self->bytes_per_sample * self->info.number_of_channels);
+      return true;
+    }
+
+    // Chunks are padded to an even size
+    offset += 8U + chunk_size + (chunk_size & 1U);
+  }
+
+  return false;
+}
+
+WavReader *wav_reader_open(const char *path) {
+  const int descriptor = open(path, O_RDONLY);
+  if (descriptor < 0) {
+    return NULL;
+  }
+
+  struct stat status;
+  if (fstat(descriptor, &status) != 0 || status.st_size <= 0) {
+    close(descriptor);
+    return NULL;
+  }
+
+  WavReader *self = (WavReader *)calloc(1U, sizeof(WavReader));
+  if (!self) {
+    close(descriptor);
+    return NULL;
+  }
+
+  self->mapping_size = (size_t)status.st_size;
+  self->mapping = (uint8_t *)mmap(NULL, self->mapping_size, PROT_READ,
+                                  MAP_PRIVATE, descriptor, 0);
+  close(descriptor);
+
+  if (self->mapping == MAP_FAILED) {
+    free(self);
+    return NULL;
+  }
+
+  // Files are streamed once from start to end
+  madvise(self->mapping, self->mapping_size, MADV_SEQUENTIAL);
+
+  if (!parse_chunks(self)) {
+    wav_reader_close(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void wav_reader_close(WavReader *self) {
+  munmap(self->mapping, self->mapping_size);
+  free(self);
+}
+
+const WavInfo *wav_reader_get_info(const WavReader *self) {
+  return &self->info;
+}
+
+static float decode_sample(const uint8_t *bytes, const WavSampleFormat format) {
+  switch (format) {
+  case WAV_PCM_16:
+    return (float)(int16_t)read_u16(bytes) / 32768.F;
+  case WAV_PCM_24:
+    return (float)((int32_t)(((uint32_t)bytes[0] << 8U) |
+                             ((uint32_t)bytes[1] << 16U) |
+                             ((uint32_t)bytes[2] << 24U)) /
+                   256) /
+           8388608.F;
+  case WAV_PCM_32:
+    return (float)(int32_t)read_u32(bytes) / 2147483648.F;
+  default: {
+    const uint32_t bits = read_u32(bytes);
+    float value = 0.F;
+    memcpy(&value, &bits, sizeof(float));
+    return value;
+  }
+  }
+}
+
+uint32_t wav_reader_read(WavReader *self, float *const *channels,
+                         const uint32_t number_of_frames) {
+  uint64_t frames = self->info.number_of_frames - self->position;
+  if (frames > number_of_frames) {
+    frames = number_of_frames;
+  }
+
+  const uint32_t number_of_channels = self->info.number_of_channels;
+  const size_t frame_size = (size_t)self->bytes_per_sample * number_of_channels;
+  const uint8_t *bytes = &self->data[self->position * frame_size];
+
+  for (uint32_t k = 0U; k < (uint32_t)frames; k++) {
+    for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+      channels[channel][k] = decode_sample(
+          &bytes[k * frame_size + channel * self->bytes_per_sample],
+          self->info.format);
+    }
+  }
+
+  self->position += frames;
+
+  return (uint32_t)frames;
+}
+
+static void write_header(uint8_t *header, const WavInfo *info,
+                         const uint32_t bytes_per_sample,
+                         const uint64_t data_size) {
+  const uint32_t block_align = bytes_per_sample * info->number_of_channels;
+
+  memcpy(header, "RIFF", 4U);
+  write_u32(&header[4],
+            (uint32_t)(data_size + (data_size & 1U) + WAV_HEADER_SIZE - 8U));
+  memcpy(&header[8], "WAVEfmt ", 8U);
+  write_u32(&header[16], 16U);
+  write_u16(&header[20], info->format == WAV_FLOAT_32 ? WAVE_FORMAT_IEEE_FLOAT
+                                                      : WAVE_FORMAT_PCM);
+  write_u16(&header[22], info->number_of_channels);
+  write_u32(&header[24], info->sample_rate);
+  write_u32(&header[28], info->sample_rate * block_align);
+  write_u16(&header[32], block_align);
+  write_u16(&header[34], bytes_per_sample * 8U);
+  memcpy(&header[36], "data", 4U);
+  write_u32(&header[40], (uint32_t)data_size);
+}
+
+WavWriter *wav_writer_open(const char *path, const WavInfo *info) {
+  WavWriter *self = (WavWriter *)calloc(1U, sizeof(WavWriter));
+  if (!self) {
+    return NULL;
+  }
+
+  self->info = *info;
+  self->bytes_per_sample = get_bytes_per_sample(info->format);
+
+  self->file = fopen(path, "wb");
+  if (!self->file) {
+    free(self);
+    return NULL;
+  }
+
+  setvbuf(self->file, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+
+  // Sizes are filled in once the whole file is written
+  uint8_t header[WAV_HEADER_SIZE];
+  write_header(header, info, self->bytes_per_sample, 0U);
+  if (fwrite(header, 1U, WAV_HEADER_SIZE, self->file) != WAV_HEADER_SIZE) {
+    fclose(self->file);
+    free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+static int32_t quantize(const float sample, const float scale,
+                        const float maximum) {
+  float value = sample * scale;
+  if (value > maximum) {
+    value = maximum;
+  } else if (value < -scale) {
+    value = -scale;
+  }
+  return (int32_t)lrintf(value);
+}
+
+static void encode_sample(uint8_t *bytes, const float sample,
+                          const WavSampleFormat format) {
+  switch (format) {
+  case WAV_PCM_16:
+    write_u16(bytes, (uint32_t)quantize(sample, 32768.F, 32767.F));
+    break;
+  case WAV_PCM_24: {
+    const uint32_t value = (uint32_t)quantize(sample, 8388608.F, 8388607.F);
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8U);
+    bytes[2] = (uint8_t)(value >> 16U);
+    break;
+  }
+  case WAV_PCM_32: {
+    // Single precision can't represent the largest 32 bit value
+    const double value = fmax(fmin((double)sample * 2147483648.0,
+                                   2147483647.0),
+                              -2147483648.0);
+    write_u32(bytes, (uint32_t)(int32_t)value);
+    break;
+  }
+  default: {
+    uint32_t bits = 0U;
+    memcpy(&bits, &sample, sizeof(float));
+    write_u32(bytes, bits);
+    break;
+  }
+  }
+}
+
+bool wav_writer_write(WavWriter *self, const float *const *channels,
+                      const uint32_t number_of_frames) {
+  const uint32_t number_of_channels = self->info.number_of_channels;
+  const size_t frame_size = (size_t)self->bytes_per_sample * number_of_channels;
+  const size_t size = frame_size * number_of_frames;
+
+  if (size > self->block_size) {
+    uint8_t *block = (uint8_t *)realloc(self->block, size);
+    if (!block) {
+      return false;
+    }
+    self->block = block;
+    self->block_size = size;
+  }
+
+  for (uint32_t k = 0U; k < number_of_frames; k++) {
+    for (uint32_t channel = 0U; channel < number_of_channels; channel++) {
+      encode_sample(
+          &self->block[k * frame_size + channel * self->bytes_per_sample],
+          channels[channel][k], self->info.format);
+    }
+  }
+
+  self->data_size += size;
+
+  return fwrite(self->block, 1U, size, self->file) == size;
+}
+
+bool wav_writer_close(WavWriter *self) {
+  uint8_t header[WAV_HEADER_SIZE];
+  write_header(header, &self->info, self->bytes_per_sample, self->data_size);
+
+  // Odd sized data chunks carry a pad byte
+  bool success = true;
+  if (self->data_size & 1U) {
+    success = fputc(0, self->file) != EOF;
+  }
+
+  success = success && fseek(self->file, 0L, SEEK_SET) == 0 &&
+            fwrite(header, 1U, WAV_HEADER_SIZE, self->file) == WAV_HEADER_SIZE;
+  success = fclose(self->file) == 0 && success;
+
+  free(self->block);
+  free(self);
+
+  return success;
+}
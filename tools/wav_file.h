@@ -0,0 +1,55 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef WAV_FILE_H
+#define WAV_FILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum WavSampleFormat {
+  WAV_PCM_16 = 0,
+  WAV_PCM_24 = 1,
+  WAV_PCM_32 = 2,
+  WAV_FLOAT_32 = 3,
+} WavSampleFormat;
+
+typedef struct WavInfo {
+  uint32_t sample_rate;
+  uint32_t number_of_channels;
+  uint64_t number_of_frames;
+  WavSampleFormat format;
+} WavInfo;
+
+typedef struct WavReader WavReader;
+typedef struct WavWriter WavWriter;
+
+WavReader *wav_reader_open(const char *path);
+void wav_reader_close(WavReader *self);
+const WavInfo *wav_reader_get_info(const WavReader *self);
+uint32_t wav_reader_read(WavReader *self, float *const *channels,
+                         uint32_t number_of_frames);
+
+WavWriter *wav_writer_open(const char *path, const WavInfo *info);
+bool wav_writer_write(WavWriter *self, const float *const *channels,
+                      uint32_t number_of_frames);
+bool wav_writer_close(WavWriter *self);
+
+#endif